@@ -0,0 +1,93 @@
+#include <new>
+
+#include "Arena.h"
+
+// Every node starts with this, so freeNode knows where it came from
+// Padded to keep the node itself aligned for anything
+union NodeHeader {
+	bool fromArena;
+	std::max_align_t align;
+};
+
+static const size_t chunkSize = 64 * 1024;
+// Chunks kept between functions, anything past that goes back to the heap
+static const unsigned int keptChunks = 16;
+
+Arena::~Arena() {
+	for (auto& chunk:chunks)
+		::operator delete(chunk.data);
+}
+
+Arena& Arena::local() {
+	static thread_local Arena arena;
+	return arena;
+}
+
+void* Arena::allocate(size_t size) {
+	// Keep every allocation aligned
+	size = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+	while (current < chunks.size()) {
+		if (used + size <= chunks[current].size) {
+			void* p = chunks[current].data + used;
+			used += size;
+			return p;
+		}
+		current++;
+		used = 0;
+	}
+
+	// Big nodes (long lists) get a chunk to themselves
+	Chunk chunk;
+	chunk.size = (size > chunkSize) ? size : chunkSize;
+	chunk.data = static_cast<char*>(::operator new(chunk.size));
+	chunks.push_back(chunk);
+	current = chunks.size() - 1;
+	used = size;
+	return chunk.data;
+}
+
+void Arena::reset() {
+	for (unsigned int i = keptChunks; i < chunks.size(); i++)
+		::operator delete(chunks[i].data);
+	if (chunks.size() > keptChunks)
+		chunks.resize(keptChunks);
+	current = 0;
+	used = 0;
+}
+
+void* Arena::allocateNode(size_t size) {
+	Arena& arena = local();
+	NodeHeader* pHeader;
+	if (arena.active) {
+		pHeader = static_cast<NodeHeader*>(arena.allocate(sizeof(NodeHeader) + size));
+		pHeader->fromArena = true;
+	} else {
+		pHeader = static_cast<NodeHeader*>(::operator new(sizeof(NodeHeader) + size));
+		pHeader->fromArena = false;
+	}
+	return pHeader + 1;
+}
+
+void Arena::freeNode(void* pNode) {
+	if (pNode == nullptr)
+		return;
+	NodeHeader* pHeader = static_cast<NodeHeader*>(pNode) - 1;
+	// Arena nodes are freed all at once by the scope
+	if (!pHeader->fromArena)
+		::operator delete(pHeader);
+}
+
+Arena::Scope::Scope() {
+	Arena& arena = local();
+	owner = !arena.active;
+	arena.active = true;
+}
+
+Arena::Scope::~Scope() {
+	if (owner) {
+		Arena& arena = local();
+		arena.active = false;
+		arena.reset();
+	}
+}
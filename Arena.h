@@ -0,0 +1,45 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <vector>
+#include <cstddef>
+
+// Bump allocator for the decompiler's expressions and statements
+// Each thread has one, reused for every function it decompiles
+// Nodes made while a Scope is open come out of it and are all given back when the scope closes,
+// anything made outside one (global vars, script info) is an ordinary heap allocation
+class Arena {
+	struct Chunk {
+		char* data;
+		size_t size;
+	};
+	std::vector<Chunk> chunks;
+	unsigned int current = 0;	// chunk being filled
+	size_t used = 0;		// in the current chunk
+	bool active = false;
+
+	void* allocate(size_t size);
+	void reset();
+
+	static Arena& local();
+	public:
+		Arena() {}
+		Arena(const Arena&) = delete;
+		~Arena();
+
+		// For operator new and delete of the IR nodes
+		static void* allocateNode(size_t size);
+		static void freeNode(void* pNode);
+
+		// Everything allocated on this thread while it is open goes when it closes
+		// Nested scopes belong to the outermost one
+		class Scope {
+			bool owner;
+			public:
+				Scope();
+				Scope(const Scope&) = delete;
+				~Scope();
+		};
+};
+
+#endif
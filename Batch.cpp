@@ -0,0 +1,535 @@
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+#include <cstring>
+#include <cstdint>
+#include <csignal>
+#include <cerrno>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <dirent.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#endif
+
+#include "Batch.h"
+#include "ThreadPool.h"
+#include "Shard.h"
+#include "Logger.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct SceneResult {
+	bool done = false;
+	std::string error;
+	std::string log;
+	long long milliseconds = 0;
+};
+
+static bool isDirectory(const std::string& path) {
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return false;
+	return S_ISDIR(info.st_mode);
+}
+
+std::vector<std::string> collectScenes(const std::vector<std::string>& inputs) {
+	std::vector<std::string> scenes;
+	for (const auto& input:inputs) {
+		if (!isDirectory(input)) {
+			scenes.push_back(input);
+			continue;
+		}
+
+		DIR* dir = opendir(input.c_str());
+		if (dir == nullptr) {
+			Logger::Error() << "Could not open directory " << input << std::endl;
+			continue;
+		}
+
+		std::string prefix = input;
+		if (prefix.back() != '/' && prefix.back() != '\\')
+			prefix += "/";
+
+		std::vector<std::string> found;
+		while (dirent* entry = readdir(dir)) {
+			std::string name(entry->d_name);
+			if (name.size() > 3 && name.compare(name.size() - 3, 3, ".ss") == 0)
+				found.push_back(prefix + name);
+		}
+		closedir(dir);
+
+		std::sort(found.begin(), found.end());
+		scenes.insert(scenes.end(), found.begin(), found.end());
+	}
+	return scenes;
+}
+
+static std::string outputName(const std::string& filename, const std::string& outDir) {
+	if (outDir.empty())
+		return filename + ".src";
+
+	std::string basename = filename.substr(filename.find_last_of("/\\") + 1);
+	return outDir + "/" + basename + ".src";
+}
+
+// Every output goes in outDir, so it has to be there before any scene is done
+static void makeOutDir(const std::string& outDir) {
+	if (!outDir.empty() && !makeDirectory(outDir)) {
+		Logger::Error() << "Could not create output directory " << outDir << std::endl;
+		throw std::runtime_error("Could not create output directory " + outDir);
+	}
+}
+
+// Longest first, so a big scene doesn't start last and hold everything up
+static std::vector<unsigned int> scheduleOrder(const std::vector<std::string>& scenes) {
+	std::vector<unsigned int> weights, order;
+	weights.reserve(scenes.size());
+	order.reserve(scenes.size());
+	for (unsigned int i = 0; i < scenes.size(); i++) {
+		weights.push_back(sceneWeight(scenes[i]));
+		order.push_back(i);
+	}
+	std::stable_sort(order.begin(), order.end(), [&weights](unsigned int a, unsigned int b) {
+		return weights[a] > weights[b];
+	});
+	return order;
+}
+
+static long long millisecondsSince(Clock::time_point start) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+}
+
+// Decompiles a scene with its log going into the result
+static void runScene(const std::string& filename, const std::string& outDir, const GlobalInfo& global, const DecompileOptions& options, SceneResult& result) {
+	std::ostringstream log;
+	auto start = Clock::now();
+	{
+		Logger::Redirect redirect(log);
+		try {
+			result.error = decompileScene(filename, outputName(filename, outDir), global, options);
+		} catch (std::bad_alloc&) {
+			result.error = "Out of memory";
+		} catch (std::exception &e) {
+			result.error = e.what();
+			if (result.error.empty())
+				result.error = "Unknown error";
+		}
+	}
+	result.milliseconds = millisecondsSince(start);
+	result.log = log.str();
+}
+
+// Prints the logs of every finished scene that isn't waiting on an earlier one
+static void printReady(const std::vector<std::string>& scenes, std::vector<SceneResult>& results, unsigned int& nextToPrint) {
+	while (nextToPrint < results.size() && results[nextToPrint].done) {
+		SceneResult& result = results[nextToPrint];
+		// Through the sink like any other log, the scene's own lines are tagged already
+		Logger::Info() << "== " << scenes[nextToPrint] << "\n";
+		Logger::Forward(result.log);
+		if (!result.error.empty())
+			Logger::Error_() << result.error << std::endl;
+		result.log.clear();
+		nextToPrint++;
+	}
+}
+
+// Returns the number of failed scenes
+static unsigned int printSummary(const std::vector<std::string>& scenes, const std::vector<SceneResult>& results, long long totalMilliseconds) {
+	unsigned int numScenes = scenes.size();
+	unsigned int numFailed = 0;
+	Logger::Info() << "\nSummary:\n";
+	for (unsigned int i = 0; i < numScenes; i++) {
+		const SceneResult& result = results[i];
+		std::ostream& line = Logger::Info() << scenes[i] << "\t" << std::to_string(result.milliseconds) << " ms\t";
+		if (result.error.empty()) {
+			line << "ok\n";
+		} else {
+			line << ANSI_RED << "failed" << ANSI_RESET << " (" << result.error << ")\n";
+			numFailed++;
+		}
+	}
+	Logger::Info() << "Decompiled " << std::to_string(numScenes - numFailed) << "/" << std::to_string(numScenes) << " scenes in " << std::to_string(totalMilliseconds) << " ms.\n";
+
+	return numFailed;
+}
+
+static std::vector<SceneResult> runOnThreads(const std::vector<std::string>& scenes, const std::string& outDir, const GlobalInfo& global, const DecompileOptions& options, unsigned int numThreads) {
+	unsigned int numScenes = scenes.size();
+	std::vector<SceneResult> results(numScenes);
+	std::mutex resultMutex;
+	std::condition_variable sceneDone;
+
+	{
+		ThreadPool pool(numThreads);
+		// Idle threads help with the functions of scenes still running
+		DecompileOptions sceneOptions = options;
+		sceneOptions.pool = &pool;
+		Logger::Info() << "Decompiling " << std::to_string(numScenes) << " scenes on " << std::to_string(pool.size()) << " threads.\n";
+
+		for (const auto& index:scheduleOrder(scenes)) {
+			pool.submit([&, index]() {
+				SceneResult result;
+				runScene(scenes[index], outDir, global, sceneOptions, result);
+				result.done = true;
+
+				std::lock_guard<std::mutex> lock(resultMutex);
+				results[index] = std::move(result);
+				sceneDone.notify_all();
+			});
+		}
+
+		// Print each log as soon as everything before it is done
+		unsigned int nextToPrint = 0;
+		while (nextToPrint < numScenes) {
+			std::unique_lock<std::mutex> lock(resultMutex);
+			sceneDone.wait(lock, [&results, nextToPrint]() { return results[nextToPrint].done; });
+			printReady(scenes, results, nextToPrint);
+		}
+	}
+
+	return results;
+}
+
+#ifndef _WIN32
+
+//
+// Process pool
+//
+
+struct Worker {
+	pid_t pid = -1;
+	int taskFd = -1;	// scene indices go down this
+	int resultFd = -1;	// results come back up this
+	int scene = -1;		// scene being decompiled, -1 if idle
+	bool finishedOne = false;	// has sent back a result since it was spawned
+	Clock::time_point start;
+};
+
+static bool readAll(int fd, void* data, size_t length) {
+	char* p = static_cast<char*>(data);
+	while (length > 0) {
+		ssize_t n = read(fd, p, length);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		length -= n;
+	}
+	return true;
+}
+
+static bool writeAll(int fd, const void* data, size_t length) {
+	const char* p = static_cast<const char*>(data);
+	while (length > 0) {
+		ssize_t n = write(fd, p, length);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		length -= n;
+	}
+	return true;
+}
+
+static bool writeString(int fd, const std::string& string) {
+	uint32_t length = string.size();
+	return writeAll(fd, &length, 4) && writeAll(fd, string.data(), length);
+}
+
+static bool readString(int fd, std::string& string) {
+	uint32_t length;
+	if (!readAll(fd, &length, 4))
+		return false;
+	string.resize(length);
+	return readAll(fd, &string[0], length);
+}
+
+// Body of a worker process: decompile whatever comes down the pipe until it closes
+static void runWorker(int taskFd, int resultFd, const std::vector<std::string>& scenes, const std::string& outDir, const GlobalInfo& global, const DecompileOptions& options, const WorkerLimits& limits) {
+	if (limits.memoryMegabytes > 0) {
+		struct rlimit limit;
+		limit.rlim_cur = limit.rlim_max = (rlim_t) limits.memoryMegabytes * 1024 * 1024;
+		if (setrlimit(RLIMIT_AS, &limit) != 0)
+			Logger::Warn() << "Could not limit worker memory.\n";
+	}
+
+	uint32_t index;
+	while (readAll(taskFd, &index, 4)) {
+		SceneResult result;
+		runScene(scenes.at(index), outDir, global, options, result);
+		if (!writeAll(resultFd, &index, 4) || !writeString(resultFd, result.error) || !writeString(resultFd, result.log))
+			break;
+	}
+}
+
+static void spawnWorker(Worker& worker, const std::vector<Worker>& workers, const std::vector<std::string>& scenes, const std::string& outDir, const GlobalInfo& global, const DecompileOptions& options, const WorkerLimits& limits) {
+	int taskPipe[2], resultPipe[2];
+	if (pipe(taskPipe) != 0 || pipe(resultPipe) != 0)
+		throw std::runtime_error("Could not create worker pipes.");
+
+	// Anything still buffered would be written by the child too
+	Logger::flush();
+
+	pid_t pid = fork();
+	if (pid < 0)
+		throw std::runtime_error("Could not fork worker.");
+
+	if (pid == 0) {
+		// Only keep our own ends, so the parent sees EOF when a worker dies
+		for (const auto& other:workers) {
+			if (other.pid > 0) {
+				close(other.taskFd);
+				close(other.resultFd);
+			}
+		}
+		close(taskPipe[1]);
+		close(resultPipe[0]);
+		signal(SIGPIPE, SIG_DFL);
+
+		runWorker(taskPipe[0], resultPipe[1], scenes, outDir, global, options, limits);
+		Logger::flush();
+		_exit(0);
+	}
+
+	close(taskPipe[0]);
+	close(resultPipe[1]);
+	worker.pid = pid;
+	worker.taskFd = taskPipe[1];
+	worker.resultFd = resultPipe[0];
+	worker.scene = -1;
+	worker.finishedOne = false;
+}
+
+// Reaps a worker that died or was killed, returning why it went
+static std::string reapWorker(Worker& worker) {
+	close(worker.taskFd);
+	close(worker.resultFd);
+
+	int status = 0;
+	waitpid(worker.pid, &status, 0);
+	worker.pid = -1;
+	worker.scene = -1;
+
+	if (WIFSIGNALED(status))
+		return "Worker crashed (" + std::string(strsignal(WTERMSIG(status))) + ")";
+	return "Worker exited with status " + std::to_string(WEXITSTATUS(status));
+}
+
+static std::vector<SceneResult> runInProcesses(const std::vector<std::string>& scenes, const std::string& outDir, const GlobalInfo& global, const DecompileOptions& options, unsigned int numWorkers, const WorkerLimits& limits) {
+	unsigned int numScenes = scenes.size();
+	std::vector<SceneResult> results(numScenes);
+	std::vector<unsigned int> order = scheduleOrder(scenes);
+
+	// Threads don't survive fork, so workers decompile their functions serially
+	DecompileOptions workerOptions = options;
+	workerOptions.pool = nullptr;
+
+	if (numWorkers == 0)
+		numWorkers = std::max(1u, std::thread::hardware_concurrency());
+	numWorkers = std::min(numWorkers, numScenes);
+	Logger::Info() << "Decompiling " << std::to_string(numScenes) << " scenes in " << std::to_string(numWorkers) << " worker processes.\n";
+
+	// A dead worker shows up as a failed write instead
+	signal(SIGPIPE, SIG_IGN);
+
+	std::vector<Worker> workers(numWorkers);
+	for (auto& worker:workers)
+		spawnWorker(worker, workers, scenes, outDir, global, workerOptions, limits);
+
+	unsigned int nextScene = 0, numDone = 0, nextToPrint = 0;
+	auto finishScene = [&](Worker& worker, std::string error, std::string log) {
+		SceneResult& result = results[worker.scene];
+		result.error = std::move(error);
+		result.log = std::move(log);
+		result.milliseconds = millisecondsSince(worker.start);
+		result.done = true;
+		worker.scene = -1;
+		worker.finishedOne = true;
+		numDone++;
+	};
+	// Fails the worker's scene with reason (or how the worker died) and starts a new worker if there's anything left to do
+	auto replaceWorker = [&](Worker& worker, std::string reason) {
+		int scene = worker.scene;
+		std::string status = reapWorker(worker);
+		if (reason.empty())
+			reason = status;
+		worker.scene = scene;
+		finishScene(worker, reason, "");
+		if (nextScene < numScenes)
+			spawnWorker(worker, workers, scenes, outDir, global, workerOptions, limits);
+	};
+
+	while (numDone < numScenes) {
+		// Hand out work
+		for (auto& worker:workers) {
+			if (worker.pid <= 0 || worker.scene >= 0 || nextScene >= numScenes)
+				continue;
+			uint32_t index = order[nextScene++];
+			worker.scene = index;
+			worker.start = Clock::now();
+			if (writeAll(worker.taskFd, &index, 4))
+				continue;
+			if (worker.finishedOne) {
+				// Died while idle, so the scene never started: put it back for a new worker
+				nextScene--;
+				worker.scene = -1;
+				reapWorker(worker);
+				spawnWorker(worker, workers, scenes, outDir, global, workerOptions, limits);
+			} else {
+				// Never got anything done, so a new one would likely go the same way
+				replaceWorker(worker, "");
+			}
+		}
+
+		// Wait for results or the next timeout
+		std::vector<pollfd> fds;
+		std::vector<Worker*> busy;
+		int timeout = -1;
+		for (auto& worker:workers) {
+			if (worker.scene < 0)
+				continue;
+			fds.push_back({worker.resultFd, POLLIN, 0});
+			busy.push_back(&worker);
+			if (limits.timeoutSeconds > 0) {
+				auto deadline = worker.start + std::chrono::seconds(limits.timeoutSeconds);
+				long long remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+				remaining = std::max(0ll, remaining);
+				if (timeout < 0 || remaining < timeout)
+					timeout = remaining;
+			}
+		}
+		if (busy.empty())
+			continue;
+
+		if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR)
+			throw std::runtime_error("Polling workers failed.");
+
+		for (unsigned int i = 0; i < busy.size(); i++) {
+			Worker& worker = *busy[i];
+			if (fds[i].revents != 0) {
+				uint32_t index;
+				std::string error, log;
+				if (readAll(worker.resultFd, &index, 4) && index == (uint32_t) worker.scene && readString(worker.resultFd, error) && readString(worker.resultFd, log))
+					finishScene(worker, error, log);
+				else
+					replaceWorker(worker, "");
+			} else if (limits.timeoutSeconds > 0 && Clock::now() - worker.start >= std::chrono::seconds(limits.timeoutSeconds)) {
+				kill(worker.pid, SIGKILL);
+				replaceWorker(worker, "Timed out after " + std::to_string(limits.timeoutSeconds) + " s");
+			}
+		}
+
+		printReady(scenes, results, nextToPrint);
+	}
+
+	// Closing the task pipes lets the workers finish
+	for (auto& worker:workers) {
+		if (worker.pid > 0) {
+			close(worker.taskFd);
+			close(worker.resultFd);
+			waitpid(worker.pid, nullptr, 0);
+		}
+	}
+	signal(SIGPIPE, SIG_DFL);
+
+	return results;
+}
+
+#else
+
+static std::vector<SceneResult> runInProcesses(const std::vector<std::string>& scenes, const std::string& outDir, const GlobalInfo& global, const DecompileOptions& options, unsigned int numWorkers, const WorkerLimits&) {
+	Logger::Warn() << "Worker processes are not supported on Windows, using threads.\n";
+	return runOnThreads(scenes, outDir, global, options, numWorkers);
+}
+
+#endif
+
+unsigned int decompileBatch(const std::vector<std::string>& scenes, const std::string& outDir, const GlobalInfo& global, const DecompileOptions& options, unsigned int numThreads) {
+	makeOutDir(outDir);
+	auto batchStart = Clock::now();
+	std::vector<SceneResult> results = runOnThreads(scenes, outDir, global, options, numThreads);
+	return printSummary(scenes, results, millisecondsSince(batchStart));
+}
+
+unsigned int decompileBatchIsolated(const std::vector<std::string>& scenes, const std::string& outDir, const GlobalInfo& global, const DecompileOptions& options, unsigned int numWorkers, const WorkerLimits& limits) {
+	makeOutDir(outDir);
+	auto batchStart = Clock::now();
+	std::vector<SceneResult> results = runInProcesses(scenes, outDir, global, options, numWorkers, limits);
+	return printSummary(scenes, results, millisecondsSince(batchStart));
+}
+
+unsigned int decompileShard(const std::vector<std::string>& scenes, const Shard& shard, const std::string& outDir, const GlobalInfo& global, const DecompileOptions& options, unsigned int numThreads, unsigned int numProcesses, const WorkerLimits& limits) {
+	std::vector<unsigned int> weights;
+	weights.reserve(scenes.size());
+	for (const auto& scene:scenes)
+		weights.push_back(sceneWeight(scene));
+
+	std::vector<unsigned int> items = shardItems(weights, shard);
+	std::vector<std::string> shardScenes;
+	shardScenes.reserve(items.size());
+	for (const auto& item:items)
+		shardScenes.push_back(scenes[item]);
+	Logger::Info() << "Shard " << std::to_string(shard.index) << "/" << std::to_string(shard.count) << " has " << std::to_string(items.size()) << " of " << std::to_string(scenes.size()) << " scenes.\n";
+
+	makeOutDir(outDir);
+	auto batchStart = Clock::now();
+	std::vector<SceneResult> results;
+	if (numProcesses > 0)
+		results = runInProcesses(shardScenes, outDir, global, options, numProcesses, limits);
+	else
+		results = runOnThreads(shardScenes, outDir, global, options, numThreads);
+
+	ShardManifest manifest;
+	manifest.shard = shard;
+	manifest.total = scenes.size();
+	manifest.milliseconds = millisecondsSince(batchStart);
+	for (unsigned int i = 0; i < items.size(); i++) {
+		ShardEntry entry;
+		entry.position = items[i];
+		entry.name = shardScenes[i];
+		entry.milliseconds = results[i].milliseconds;
+		entry.error = results[i].error;
+		manifest.entries.push_back(entry);
+
+		// Failed scenes can still leave a partial output behind, and the dumps go next to it
+		std::string output = outputName(shardScenes[i], outDir);
+		for (const char* extension:{".src", ".asm", ".diag", ".trace"}) {
+			std::string file = sideFileName(output, extension);
+			if (std::ifstream(file).is_open())
+				manifest.files.push_back(file.substr(outDir.size() + 1));
+		}
+	}
+	if (!manifest.write(outDir))
+		throw std::exception();
+
+	return printSummary(shardScenes, results, manifest.milliseconds);
+}
+
+unsigned int mergeBatch(const std::vector<std::string>& shardDirs, const std::string& outDir) {
+	ShardManifest merged;
+	if (!mergeShards(shardDirs, outDir, merged))
+		throw std::exception();
+
+	std::vector<std::string> scenes;
+	std::vector<SceneResult> results;
+	for (const auto& entry:merged.entries) {
+		scenes.push_back(entry.name);
+		SceneResult result;
+		result.error = entry.error;
+		result.milliseconds = entry.milliseconds;
+		results.push_back(result);
+	}
+	Logger::Info() << "Merged " << std::to_string(merged.shard.count) << " shards.\n";
+	return printSummary(scenes, results, merged.milliseconds);
+}
@@ -0,0 +1,36 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+
+#include "Decompiler.h"
+#include "Shard.h"
+
+// Expands directories into the scenes (.ss) they contain, sorted by name
+std::vector<std::string> collectScenes(const std::vector<std::string>& inputs);
+
+// Decompiles every scene on numThreads threads, biggest scenes first
+// Logs and the summary come out in input order no matter how the scenes were scheduled
+// Returns the number of scenes that failed
+unsigned int decompileBatch(const std::vector<std::string>& scenes, const std::string& outDir, const GlobalInfo& global, const DecompileOptions& options, unsigned int numThreads);
+
+struct WorkerLimits {
+	unsigned int timeoutSeconds = 0;	// per scene, 0 for none
+	unsigned int memoryMegabytes = 0;	// per worker, 0 for none
+};
+
+// Same as decompileBatch, but each scene runs in one of numWorkers forked processes
+// Workers inherit the global info, so it is still only read once
+// A scene that crashes its worker, runs out of memory or takes too long only fails itself, and the worker is replaced
+unsigned int decompileBatchIsolated(const std::vector<std::string>& scenes, const std::string& outDir, const GlobalInfo& global, const DecompileOptions& options, unsigned int numWorkers, const WorkerLimits& limits);
+
+// Decompiles this machine's share of the scenes (balanced by bytecode size) into outDir
+// on threads, or worker processes if numProcesses is set, and writes the shard's manifest next to them
+unsigned int decompileShard(const std::vector<std::string>& scenes, const Shard& shard, const std::string& outDir, const GlobalInfo& global, const DecompileOptions& options, unsigned int numThreads, unsigned int numProcesses, const WorkerLimits& limits);
+
+// Combines the outputs of every shard into outDir, and prints the summary a single run would have
+// Throws if a shard is missing or doesn't belong to the same batch
+unsigned int mergeBatch(const std::vector<std::string>& shardDirs, const std::string& outDir);
+
+#endif
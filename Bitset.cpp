@@ -18,7 +18,7 @@ void Bitset::set(unsigned int pos) {
 		arr[pos/32] |= 1 << (pos % 32);
 }
 
-bool Bitset::get(unsigned int pos) {
+bool Bitset::get(unsigned int pos) const {
 	if (pos < size)
 		return (arr[pos/32] & 1 << (pos % 32));
 
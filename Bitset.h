@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <limits>
+#include <cstdint>
 
 // Quick and dirty bitset (bit set? BitSet?)
 // Could use boost (should) but 
@@ -22,7 +23,7 @@ class Bitset {
 
 		void clear();
 		void set(unsigned int pos);
-		bool get(unsigned int pos);
+		bool get(unsigned int pos) const;
 };
 
 #endif
\ No newline at end of file
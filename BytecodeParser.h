@@ -3,8 +3,11 @@
 
 #include <vector>
 #include <map>
+#include <memory>
 
 #include "Statements.h"
+#include "Instructions.h"
+#include "Diagnostics.h"
 
 
 
@@ -13,81 +16,158 @@ struct Label {
 	Label(unsigned int offset) : address(offset) {}
 };
 
+// Operand stack, kept as a persistent list so copying it (a snapshot for a branch) is O(1)
+// Copies share their nodes, and an expression is only cloned when it is popped while still shared
 class Stack {
-	std::vector<Value> values;
+	struct Node {
+		Value value;
+		std::shared_ptr<Node> next;
+		// Set instead of value by duplicateElement, the node holding the original
+		std::shared_ptr<Node> source;
+
+		const Expression* get() const { return source ? source->value.get() : value.get(); }
+	};
+	std::shared_ptr<Node> top;
 	std::vector<unsigned int> stackHeights;
 
+	void dropTop();
+	// Frees the nodes only node holds in a loop, as letting them go one by one recurses once per node
+	// which a long enough stack in a broken scene would run off the end of the thread's stack with
+	static void unlink(std::shared_ptr<Node> node);
+
 	public:
 		Stack();
-		Stack(const Stack& copy);
-		Stack& operator=(const Stack& copy);
+		Stack(const Stack& other) = default;
+		Stack(Stack&& other) = default;
+		~Stack();
+		Stack& operator =(const Stack& other);
+		Stack& operator =(Stack&& other);
 
-		bool empty() { return values.size() == 0; }
+		bool empty() const { return top == nullptr; }
 
 		// Caller needs to check for emptiness
-		Value& back() { return values.back(); }
-		std::vector<Value>::iterator end() { return values.end(); }
+		// Could be shared with other snapshots, so look but don't touch
+		const Expression* back() const { return top->get(); }
 
 		unsigned int& height() { return stackHeights.back(); }
+		// Height of each open frame, outermost first
+		const std::vector<unsigned int>& getHeights() const { return stackHeights; }
 		void openFrame();
 		void closeFrame();
 		void duplicateElement();
-		std::vector<Value>::iterator getFrame();
+		// Pops the current frame, bottom first, and closes it
+		std::vector<Value> takeFrame();
 
 
 		Value pop();
 		void push(Expression* pValue);
 
-		std::string print();
+		std::string print() const;
 };
 
 struct BasicBlock;
 struct ProgBranch;
 
+struct LineEntry {
+	unsigned int address;
+	unsigned int line;
+};
+
 struct Function {
-	std::string name = "FN_ERROR";
+	Symbol name = "FN_ERROR";
 	unsigned int address = 0xFFFFFFFF;
 	unsigned int index = 0xFFFFFFFF;
 
 	Function() {}
-	Function(std::string name_, unsigned int address_, int index_) : name(name_), address(address_), index(index_) {}
+	Function(Symbol name_, unsigned int address_, int index_) : name(name_), address(address_), index(index_) {}
+};
+
+// What the parser saw at an instruction, enough to write its assembler later
+// The rest comes from the instruction table, so nothing is formatted unless the assembler is dumped
+struct AsmRecord {
+	enum Kind : unsigned char {
+		INSTRUCTION,
+		BLANK,		// parser gave up on it
+		UNMAPPED	// just past a return, only used if nothing else is there
+	};
+	unsigned int address;
+	Kind kind;
+	bool hasExtra = false;	// call with an int after it
+	unsigned int extra = 0;
+
+	AsmRecord(unsigned int address_, Kind kind_ = INSTRUCTION) : address(address_), kind(kind_) {}
 };
 
 typedef class BytecodeParser Parser;
-class BytecodeBuffer;
 class ScriptInfo;
 class ControlFlowGraph;
 
 class BytecodeParser {
 	private:
-		BytecodeBuffer* buf;
+		const InstructionTable& instructions;
+		// For an instruction the table doesn't have (a label into the middle of one)
+		InstructionTable oddInstructions;
+		// Instruction being parsed, and where its operands are read from
+		const InstructionTable* pTable = nullptr;
+		unsigned int operand = 0;
+		unsigned int nextAddress = 0;
+		unsigned char fetch(unsigned int address);
+
+		// Line from the last 0x01, until a statement takes it
+		int pendingLine = -1;
+		void flushLine(BasicBlock* pBlock);
+		// Every line number seen, by address
+		std::vector<LineEntry> lines;
+		void addLine(unsigned int address, unsigned int line);
 
 		unsigned int numParams = 0;	// part of state
+		unsigned int numTemporaries = 0;
 		std::vector<Value> localVars; // please no corrupt
 		Value getLocalVar(unsigned int index);
 	public:
 		std::vector<ProgBranch> toTraverse;
+		// By block index, set once a block has been queued
+		std::vector<bool> queuedBlocks;
+		// By block index, the stack heights it was first reached with and where from
+		// Every other way into the block should agree, otherwise its expressions only fit one of them
+		struct BlockEntry {
+			std::vector<unsigned int> heights;
+			unsigned int from = 0xFFFFFFFF;
+		};
+		std::vector<BlockEntry> blockEntries;
+		void checkEntry(const BasicBlock* pBlock, const Stack& entryStack);
+		unsigned int numBadEntries = 0;
 		unsigned int instAddress = 0;
 		// operand stack
 		Stack stack;
 
 		//std::vector<CallRet> callStack;
 
-		unsigned int getInt();
-		unsigned char getChar();
+		// Operands of the current instruction, in the order the opcode table gives them
+		// fetch has already checked that they're all there
+		unsigned int getInt() { return pTable->getOperand(operand++); }
+		unsigned char getChar() { return getInt(); }
+		// The int some calls have after their operands
+		unsigned int getTrailingInt();
 		Value getArg(unsigned int type, const ScriptInfo& info);
-		unsigned int getArgs(std::vector<Value> &args, std::vector<unsigned int> &argTypes, const ScriptInfo& info);
+		unsigned int getArgs(ValueList &args, TypeList &argTypes, const ScriptInfo& info);
 		Expression* getLValue(const ScriptInfo &info);
 
 		FunctionExpr* getCallFunction(const ScriptInfo& info);
 	public:
-		BytecodeParser(std::ifstream &f, HeaderPair index);
-		~BytecodeParser();
+		// Only reads the table, so any number of parsers can share it
+		BytecodeParser(const InstructionTable& instructions);
 
 		void addBranch(BasicBlock* pBlock, Stack* saveStack = nullptr);
-		void parse(ControlFlowGraph& cfg, ScriptInfo& info, std::map<unsigned int, std::string> *pAsmLines = nullptr);
+		// Line number of the code at address, or -1 if there isn't one before it
+		int getLine(unsigned int address) const;
+		void parse(ControlFlowGraph& cfg, const ScriptInfo& info, std::vector<AsmRecord> *pAsm = nullptr);
 
 		unsigned char addressWidth;
+		// What was wrong with the bytecode, kept until the caller wants it printed
+		DiagnosticLog diagnostics;
+		unsigned int getNumTemporaries() const { return numTemporaries; }
+		static unsigned char getAddressWidth(unsigned int length);
 
 		std::string getFunctionSignature();
 };
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 
 #include "BytecodeParser.h"
 #include "Statements.h"
@@ -85,7 +86,7 @@ void NaturalLoop::merge(Block* tail) {
 	if (std::find(blocks.begin(), blocks.end(), tail) != blocks.end()) {
 		return;
 	}
-	Logger::VVDebug() << "Loop found from L" << std::to_string(tail->index) << " to L" << std::to_string(header->index) << "\n";
+	LOG_VVDEBUG() << "Loop found from L" << std::to_string(tail->index) << " to L" << std::to_string(header->index) << "\n";
 
 	// DFS stack for backwards traversal
 	std::vector<Block*> toSearch;
@@ -126,15 +127,18 @@ bool NaturalLoop::operator <(const NaturalLoop& other) const {
 
 // Guarantee this will be the only way new blocks are made
 Block* ControlFlowGraph::getBlock(unsigned int address, bool createIfNone) {
-	auto pBlockIt = std::find_if(blocks.begin(), blocks.end(), checkAddress(address));
-	if (pBlockIt != blocks.end())
-		return (*pBlockIt);
+	auto pBlockIt = blocksByAddress.find(address);
+	if (pBlockIt != blocksByAddress.end())
+		return pBlockIt->second;
 
 	if (!createIfNone)
 		return nullptr;
 
-	Block* pBlock = new Block(address, blockIndex++);
+	arena.emplace_back(address, blockIndex++);
+	Block* pBlock = &arena.back();
 	blocks.push_back(pBlock);
+	blocksByAddress[address] = pBlock;
+	numBlocks++;
 	return pBlock;
 }
 
@@ -157,8 +161,10 @@ void ControlFlowGraph::removeBlock(Block* pBlock) {
 	}
 	pBlock->succ.clear();
 	// Remove from graph entirely, hope there's nothing remaining (remember to handle the calls)
-	blocks.erase(std::remove(blocks.begin(), blocks.end(), pBlock), blocks.end());
-	removedBlocks.push_back(pBlock);
+	// The block itself stays in the arena until the graph goes
+	blocks[pBlock->index] = nullptr;
+	blocksByAddress.erase(pBlock->startAddress);
+	numBlocks--;
 
 	// Remove from any loops its part of
 	for (auto& loopStatement:pBlock->loops)
@@ -166,7 +172,7 @@ void ControlFlowGraph::removeBlock(Block* pBlock) {
 }
 
 void ControlFlowGraph::mergeBlocks(Block* pBlock, Block* pSucc) {
-	Logger::VDebug() << "Merging L" << std::to_string(pBlock->index) << " and L" << std::to_string(pSucc->index) << ".\n";
+	LOG_VDEBUG() << "Merging L" << std::to_string(pBlock->index) << " and L" << std::to_string(pSucc->index) << ".\n";
 
 	// Update successors
 	pBlock->succ.insert(pBlock->succ.end(), pSucc->succ.begin(), pSucc->succ.end());
@@ -188,8 +194,8 @@ void ControlFlowGraph::mergeBlocks(Block* pBlock, Block* pSucc) {
 
 // For now, no blocks are allowed to have been removed yet
 std::vector<Bitset> ControlFlowGraph::findDominators() {
-	int numBlocks = blocks.size();
-  	std::vector<Bitset> dominators(numBlocks, Bitset(numBlocks, true));
+	int size = blocks.size();
+  	std::vector<Bitset> dominators(size, Bitset(size, true));
   	if (blocks[0]->index != 0) {
   		Logger::Error() << "Blocks corrupted (" << std::to_string(blocks[0]->index) << ")\n";
   		return dominators;
@@ -204,7 +210,7 @@ std::vector<Bitset> ControlFlowGraph::findDominators() {
  		changed = false;
 
  		for (const auto& pBlock:blocks) {
- 			if (pBlock->index == 0)
+ 			if (pBlock == nullptr || pBlock->index == 0)
  				continue;
  			
  			Bitset& currDoms = dominators.at(pBlock->index);
@@ -224,6 +230,8 @@ std::vector<Loop> ControlFlowGraph::findLoops() {
 	std::vector<Loop> loops;
 	std::vector<Bitset> dominators = findDominators();
 	for (const auto& pBlock:blocks) {
+		if (pBlock == nullptr)
+			continue;
 		Bitset currDom = dominators.at(pBlock->index);
 		for (const auto& pSucc:pBlock->succ) {
 			// If this is a back edge
@@ -246,7 +254,7 @@ ControlFlowGraph::ControlFlowGraph(Parser &parser, std::vector<unsigned int> ent
 	for (const auto& address:entrypoints) {
 		if (address == 0x0)
 			continue;
-		Logger::VDebug() << "Entrypoint added at 0x" << toHex(address) << std::endl;
+		LOG_VDEBUG() << "Entrypoint added at 0x" << toHex(address) << std::endl;
 		pBlock = getBlock(address);
 		parser.addBranch(pBlock);
 
@@ -255,12 +263,6 @@ ControlFlowGraph::ControlFlowGraph(Parser &parser, std::vector<unsigned int> ent
 }
 
 ControlFlowGraph::~ControlFlowGraph() {
-	for (auto &pBlock:blocks) {
-		delete pBlock;
-	}
-	for (auto &pBlock:removedBlocks) {
-		delete pBlock;
-	}
 }
 /*
 
@@ -451,16 +453,18 @@ bool ControlFlowGraph::StructureMerge(Block* pBlock) {
 }
 
 void ControlFlowGraph::structureStatements() {
-	Logger::Debug() << "Structuring loops.\n";
+	LOG_DEBUG() << "Structuring loops.\n";
 	StructureLoops();
 
 
-	Logger::Debug() << "Structuring if else statements.\n";
+	LOG_DEBUG() << "Structuring if else statements.\n";
 	// Structure ifs and simplify blocks
 	bool changed = true;
 	while (changed) {
 		changed = false;
 		for (auto &pBlock:blocks) {
+			if (pBlock == nullptr)
+				continue;
 			if (StructureIf(pBlock)) {
 				changed = true;
 				break;
@@ -473,6 +477,8 @@ void ControlFlowGraph::structureStatements() {
 	// Turn ifs into switches
 	// needs to be recursive or keep track of ifs previously
 	for (auto &pBlock:blocks) {
+		if (pBlock == nullptr)
+			continue;
 		for (auto &statement:pBlock->statements) {
 			SwitchStatement* pSwitch = statement->foldSwitch();
 			if (pSwitch != nullptr) {
@@ -485,7 +491,7 @@ void ControlFlowGraph::structureStatements() {
 	
 }
 
-void ControlFlowGraph::printBlocks(std::ofstream& out, unsigned int indentation) {
+void ControlFlowGraph::printBlocks(std::ostream& out, unsigned int indentation) {
 	std::vector<Block*> toPrint, printed;
 
 	Block* entryBlock = blocks.at(0);
@@ -510,7 +516,7 @@ void ControlFlowGraph::printBlocks(std::ofstream& out, unsigned int indentation)
 		if (pBlock->index > 0) {
 			//unsigned int entryIndex = std::find(entryBlock->succ.begin(), entryBlock->succ.end(), pBlock) - entryBlock->succ.begin();
 			
-			if (blocks.size() > 1)
+			if (numBlocks > 1)
 				out << std::string(indentation, '\t') << "L" << std::to_string(pBlock->index) << "@0x" << toHex(pBlock->startAddress) << ":\n";
 			
 			for (auto &pStatement:pBlock->statements) {
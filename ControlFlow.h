@@ -2,8 +2,11 @@
 #define CONTROLFLOW_H
 
 #include <vector>
+#include <deque>
+#include <unordered_map>
 
 #include "Bitset.h"
+#include "SmallVector.h"
 
 class Statement;
 typedef std::vector<Statement*> StatementBlock;
@@ -26,9 +29,12 @@ typedef struct BasicBlock {
 
 	StatementBlock statements;
 
-	std::vector<BasicBlock*> pred, succ, calls;
+	// At most two successors, and few blocks are jumped to from more than a couple of places
+	SmallVector<BasicBlock*, 4> pred;
+	SmallVector<BasicBlock*, 2> succ, calls;
 
 	BasicBlock(unsigned int address, int index_) : index(index_), startAddress(address){}
+	BasicBlock(const BasicBlock&) = delete;
 	~BasicBlock();
 
 	void addSuccessor(BasicBlock*);
@@ -42,7 +48,7 @@ typedef struct BasicBlock {
 
 typedef struct NaturalLoop {
 	Block* header;
-	std::vector<Block*> tails;
+	SmallVector<Block*, 2> tails;
 	std::vector<Block*> blocks;
 
 	NaturalLoop(Block* header, Block* tail);
@@ -57,15 +63,13 @@ struct Function;
 class ControlFlowGraph {
 	private:
 		int blockIndex = 0;
-		std::vector<Block*> blocks, removedBlocks;
-		struct checkAddress {
-			unsigned int address;
-		    checkAddress(int address_) : address(address_) {}
-
-		    bool operator ()(Block* const& pBlock) const {
-		    	return pBlock->startAddress == address;
-		   	}
-		};
+		// Every block made, removed or not, so pointers to them stay good as long as the graph
+		std::deque<Block> arena;
+		// Indexed by block index, null once a block is removed
+		std::vector<Block*> blocks;
+		unsigned int numBlocks = 0;
+		// Blocks still in the graph by start address
+		std::unordered_map<unsigned int, Block*> blocksByAddress;
 
 		std::vector<Bitset> findDominators();
 		std::vector<Loop> findLoops();
@@ -86,7 +90,7 @@ class ControlFlowGraph {
 
 		void structureStatements();
 
-		void printBlocks(std::ofstream& out, unsigned int indentation = 0);
+		void printBlocks(std::ostream& out, unsigned int indentation = 0);
 		void dumpGraph(std::string filename);
 };
 
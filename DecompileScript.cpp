@@ -9,6 +9,7 @@
 #include <memory>
 #include <bitset>
 
+#include <cstdio>
 #include <cassert>
 #include <unistd.h>
 #include <getopt.h>
@@ -20,75 +21,56 @@
 #include "BytecodeParser.h"
 #include "Statements.h"
 #include "ControlFlow.h"
+#include "Bitset.h"
+#include "Decompiler.h"
+#include "Batch.h"
+#include "ThreadPool.h"
+#include "Server.h"
 
-class BytecodeBuffer {
-	private:
-		unsigned char* bytecode = NULL;
-		unsigned int dataLength = 0;
-		unsigned int currAddress = 0;
-
-	public:
-		unsigned int getInt();
-		unsigned char getChar();
-		bool done() {
-			return currAddress == dataLength;
-		};
-		unsigned int getAddress() {
-			return currAddress;
-		};
-
-		void setAddress(unsigned int address) {
-			currAddress = address;
-		}
-
-		BytecodeBuffer(std::ifstream& f, unsigned int length);
-		~BytecodeBuffer();
-};
-
-std::string printArgList(const std::vector<unsigned int>& argTypes);
+std::string printArgList(const TypeList& argTypes);
 
 class ScriptInfo {
 	private:
 		std::vector<Label> labels, entrypoints, functions;
 		std::vector<unsigned int> globalFunctionDefinitions;
+		// Addresses with a label, where the parser has to start a new block
+		Bitset labelled;
 	private:
 		int fileIndex;
-		StringList sceneNames;
+		const GlobalInfo& global;
 		StringList functionNames;
 
 		StringList stringData;
 		StringList localVarNames;
-		std::vector<Value> globalVars;
-		std::vector<Value> staticVars;
-		std::vector<Function> globalCommands;
+		std::vector<VariableInfo> staticVars;
 		std::vector<Function> localCommands;
+		// Position in localCommands of each command index past the global ones, -1 if there is none
+		std::vector<int> localCommandTable;
+		// Same for indices too far out to keep in the table, which a sane script doesn't have
+		std::map<unsigned int, int> farLocalCommands;
 
 		void readLocalCommands(std::ifstream&, const HeaderPair&);
 		void readStaticVars(std::ifstream&, const HeaderPair&, const StringList&);
 	public:
-		ScriptInfo(std::ifstream &f, const ScriptHeader& header, int fileIndex, std::string filename);
+		ScriptInfo(std::ifstream &f, const ScriptHeader& header, const GlobalInfo& global, int fileIndex, std::string filename);
 
 		std::string getString(unsigned int index) const;
 		std::string getLocalVarName(unsigned int index) const;
 		Value getGlobalVar(unsigned int index) const;
-		std::string getCommand(unsigned int index) const;
-
-		void readGlobalInfo(std::string filename);
+		Symbol getCommand(unsigned int index) const;
 
-		std::vector<unsigned int> getEntrypoints();
-		std::vector<Function> getFunctionAddresses();
-		unsigned int getLabelAddress(unsigned int labelIndex);
-		bool isLabelled(unsigned int address);
+		std::vector<unsigned int> getEntrypoints() const;
+		std::vector<Function> getFunctionAddresses() const;
+		unsigned int getLabelAddress(unsigned int labelIndex) const;
+		bool isLabelled(unsigned int address) const;
 };
 
 	
 
 void readScriptHeader(std::ifstream &f, ScriptHeader &header) {
 	f.read((char*) &header.headerSize, 4);
-	if (header.headerSize != 0x84) {
-		Logger::Error() << "Expected script header size 0x84, got 0x" << std::hex << header.headerSize << std::endl;
-		throw std::exception();
-	}
+	if (header.headerSize != 0x84)
+		throw std::runtime_error("Expected script header size 0x84, got 0x" + toHex(header.headerSize));
 	readHeaderPair(f, header.bytecode);
 	readHeaderPair(f, header.stringIndex);
 	readHeaderPair(f, header.stringData);
@@ -127,6 +109,16 @@ void readLabels(std::ifstream &stream, std::vector<Label> &labels, const HeaderP
 	}
 }
 
+void readBytecode(std::ifstream &f, const HeaderPair& index, std::vector<unsigned char>& bytecode) {
+	bytecode.resize(index.count);
+
+	f.seekg(index.offset, std::ios_base::beg);
+	f.read((char*) bytecode.data(), index.count);
+	if (f.fail())
+		throw std::runtime_error("Tried to read " + std::to_string(index.count) + " bytes of bytecode, got " + std::to_string(f.gcount()));
+	LOG_DEBUG() << "Read " << f.gcount() << " bytes of bytecode." << std::endl;
+}
+
 
 std::string ScriptInfo::getString(unsigned int index) const {
 	if (index >= stringData.size()) {
@@ -149,51 +141,60 @@ Value ScriptInfo::getGlobalVar(unsigned int index) const {
 		return make_unique<ErrValueExpr>("Invalid index for global var.");
 
 
-	if (index >= globalVars.size()) {
-		index -= globalVars.size();
+	if (index >= global.globalVars.size()) {
+		index -= global.globalVars.size();
 		if (index >= staticVars.size())
 			throw std::out_of_range("Error: Global var index " + std::to_string(index) + " out of range.");
 		
-		return Value(staticVars[index]->clone());
+		return make_unique<VariableExpression>(staticVars[index]);
 	}
 
-	return Value(globalVars[index]->clone());
+	return make_unique<VariableExpression>(global.globalVars[index]);
 }
 
-std::string ScriptInfo::getCommand(unsigned int index) const {
+Symbol ScriptInfo::getCommand(unsigned int index) const {
+	static const Symbol invalidCommand("ERROR_INVALIDCOMMAND"), missingCommand("ERROR");
 	if (index & 0xFF000000)
-		return "ERROR_INVALIDCOMMAND";
-
-	if (index >= globalCommands.size()) {
-		//index -= globalCommands.size();
-		//if (index >= localCommands.size()) {
-		//	Logger::Error() << "Command index " << std::to_string(index) << " is out of range.\n";
-		//	return "ERROR";
-		//}
-
-		//return localCommands[index].name;
-		auto funcIt = std::find_if(localCommands.begin(), localCommands.end(), [index](Function func) {
-			return (func.index == index);
-		});
-
-		if (funcIt == localCommands.end())
-			return "ERROR";
+		return invalidCommand;
+
+	if (index >= global.globalCommands.size()) {
+		index -= global.globalCommands.size();
+		if (index < localCommandTable.size()) {
+			if (localCommandTable[index] < 0)
+				return missingCommand;
+			return localCommands[localCommandTable[index]].name;
+		}
 
-		return funcIt->name;
+		auto it = farLocalCommands.find(index);
+		if (it == farLocalCommands.end())
+			return missingCommand;
+		return localCommands[it->second].name;
 	}
 
-	return globalCommands[index].name;
+	return global.globalCommands[index].name;
 }
 
-ScriptInfo::ScriptInfo(std::ifstream &stream, const ScriptHeader &header, int index, std::string filename) : fileIndex(index) {
+ScriptInfo::ScriptInfo(std::ifstream &stream, const ScriptHeader &header, const GlobalInfo& global_, int index, std::string filename) : fileIndex(index), global(global_) {
 
 	readLabels(stream, labels, header.labels);
+	// The parser never gets past the end, so labels outside the bytecode don't matter
+	labelled = Bitset(header.bytecode.count + 1);
+	for (const auto& label:labels)
+		labelled.set(label.address);
+
 	readLabels(stream, entrypoints, header.entrypoints);
 	readLabels(stream, functions, header.functions);
 	Logger::Info() << "Found " << std::to_string(functions.size()) << " functions.\n";
 
-	// Needs to be done before reading local commands but after reading functions
-	readGlobalInfo(filename);
+	if (fileIndex < 0) {
+		std::string basename = filename.substr(filename.find_last_of("/\\") + 1);
+		basename = basename.substr(0, basename.find_last_of('.'));
+		for (unsigned int i = 0; i < global.sceneNames.size(); i++) {
+			if (basename.compare(global.sceneNames[i]) == 0) {
+				Logger::Info() << "Determined file index: " << i << "(" << global.sceneNames[i] << ")\n";
+			}
+		}
+	}
 
 	readStrings(stream, stringData, header.stringIndex, header.stringData, true);
 	readStrings(stream, localVarNames, header.localVarIndex, header.localVarNames);
@@ -206,28 +207,20 @@ ScriptInfo::ScriptInfo(std::ifstream &stream, const ScriptHeader &header, int in
 	readStaticVars(stream, header.staticVarTypes, staticVarNames);
 }
 
-void ScriptInfo::readGlobalInfo(std::string filename) {
-	std::ifstream globalInfoFile("SceneInfo.dat", std::ios::in | std::ios::binary);
+bool GlobalInfo::read(std::string filename) {
+	std::ifstream globalInfoFile(filename, std::ios::in | std::ios::binary);
 	if (!globalInfoFile.is_open()) {
 		Logger::Error() << "Could not open global scene info.\n";
-		return;
+		return false;
 	}
 	std::string name;
 	unsigned int count;
 	
 	// Scene names
-	std::string basename = filename.substr(filename.find_last_of("/\\") + 1);
-	basename = basename.substr(0, basename.find_last_of('.'));
-	
 	globalInfoFile.read((char*) &count, 4);	
 	for (unsigned int i = 0; i < count; i++) {
 		std::getline(globalInfoFile, name, '\0');
 		sceneNames.push_back(name);
-		if (fileIndex < 0) {
-			if (basename.compare(name) == 0) {
-				Logger::Info() << "Determined file index: " << i << "(" << name << ")\n";
-			}
-		}
 	}
 	
 	// Global vars
@@ -239,7 +232,7 @@ void ScriptInfo::readGlobalInfo(std::string filename) {
 		globalInfoFile.read((char*) &length, 4);
 		std::getline(globalInfoFile, name, '\0');
 
-		globalVars.push_back(make_unique<VariableExpression>(name, type, length));
+		globalVars.emplace_back(name, type, length);
 	}
 	Logger::Info() << "Read " << std::to_string(count) << " global variables.\n";
 
@@ -262,29 +255,53 @@ void ScriptInfo::readGlobalInfo(std::string filename) {
 	Logger::Info() << "Read " << std::to_string(count) << " global commands.\n";
 
 	globalInfoFile.close();
+	return true;
 }
 
 void ScriptInfo::readLocalCommands(std::ifstream& stream, const HeaderPair& pairIndex) {
 	unsigned int numCommands = pairIndex.count;
-	unsigned int numGlobalCommands = globalCommands.size();
+	unsigned int numGlobalCommands = global.globalCommands.size();
+
+	// Function indices sorted by address, the first function at an address first
+	std::vector<unsigned int> functionsByAddress(functions.size());
+	for (unsigned int i = 0; i < functions.size(); i++)
+		functionsByAddress[i] = i;
+	std::stable_sort(functionsByAddress.begin(), functionsByAddress.end(), [this](unsigned int a, unsigned int b) {
+		return functions[a].address < functions[b].address;
+	});
 
 	unsigned int commandIndex, commandOffset;
 	stream.seekg(pairIndex.offset, std::ios::beg);
 	for (unsigned int i = 0; i < numCommands; i++) {
 		stream.read((char*) &commandIndex, 4);
 		stream.read((char*) &commandOffset, 4);
+		if (!stream) {
+			Logger::Error() << "Command table cut short after " << std::to_string(i) << " commands.\n";
+			break;
+		}
 
 		 if (commandIndex >= numGlobalCommands) {
 			// Static function
 
-			auto predAtOffset = [commandOffset](Label function) {
-				return (function.address == commandOffset);
-			};
+			auto pFunction = std::lower_bound(functionsByAddress.begin(), functionsByAddress.end(), commandOffset, [this](unsigned int fn, unsigned int address) {
+				return functions[fn].address < address;
+			});
 
-			unsigned int fnIndex = std::find_if(functions.begin(), functions.end(), predAtOffset) - functions.begin();
-			if (fnIndex != functions.size()) {
+			if (pFunction != functionsByAddress.end() && functions[*pFunction].address == commandOffset) {
+				unsigned int fnIndex = *pFunction;
 				localCommands.emplace_back(functionNames.at(fnIndex), commandOffset, commandIndex);
-				Logger::Debug() << "Local command index " << std::to_string(commandIndex + numGlobalCommands) << " in range, it was " << functionNames.at(fnIndex) <<  "\n";
+				LOG_DEBUG() << "Local command index " << std::to_string(commandIndex + numGlobalCommands) << " in range, it was " << functionNames.at(fnIndex) <<  "\n";
+
+				// The first command with an index wins, same as searching in order
+				unsigned int slot = commandIndex - numGlobalCommands;
+				if (slot < 4 * numCommands + 0x100) {
+					if (slot >= localCommandTable.size())
+						localCommandTable.resize(slot + 1, -1);
+					if (localCommandTable[slot] < 0)
+						localCommandTable[slot] = localCommands.size() - 1;
+				} else {
+					farLocalCommands.insert(std::make_pair(slot, localCommands.size() - 1));
+				}
 			} else {
 				Logger::Error() << "Command " << std::to_string(commandIndex) << " at 0x" << toHex(commandOffset) << " not found.\n";
 			}
@@ -306,13 +323,13 @@ void ScriptInfo::readStaticVars(std::ifstream& stream, const HeaderPair& varType
 		stream.read((char*) &type, 4);
 		stream.read((char*) &length, 4);
 
-		staticVars.push_back(make_unique<VariableExpression>(varNames.at(i), type, length));
+		staticVars.emplace_back(varNames.at(i), type, length);
 	}
 
 	Logger::Info() << "Read " << std::to_string(numVars) << " static variables.\n";
 }
 
-std::vector<unsigned int> ScriptInfo::getEntrypoints() {
+std::vector<unsigned int> ScriptInfo::getEntrypoints() const {
 	std::vector<unsigned int> addresses;
 	for (const auto& ep:entrypoints)
 		addresses.push_back(ep.address);
@@ -320,10 +337,10 @@ std::vector<unsigned int> ScriptInfo::getEntrypoints() {
 	return addresses;
 }
 
-std::vector<Function> ScriptInfo::getFunctionAddresses() {
+std::vector<Function> ScriptInfo::getFunctionAddresses() const {
 	std::vector<Function> fns;
 	for (const auto& index:globalFunctionDefinitions) {
-		fns.push_back(globalCommands.at(index));
+		fns.push_back(global.globalCommands.at(index));
 	}
 
 	fns.insert(fns.end(), localCommands.begin(), localCommands.end());
@@ -331,125 +348,360 @@ std::vector<Function> ScriptInfo::getFunctionAddresses() {
 	return fns;
 }
 
-unsigned int ScriptInfo::getLabelAddress(unsigned int labelIndex) {
+unsigned int ScriptInfo::getLabelAddress(unsigned int labelIndex) const {
 	if (labelIndex >= labels.size()) {
 		throw std::out_of_range("Label index out of range.");
 	}
 	return labels[labelIndex].address;
 }
 
-bool ScriptInfo::isLabelled(unsigned int address) {
-	auto pLabel = std::find_if(labels.begin(), labels.end(), [address](Label label) {
-		return label.address == address;
-	});
+bool ScriptInfo::isLabelled(unsigned int address) const {
+	return labelled.get(address);
+}
+
+
 
-	return (pLabel != labels.end());
+unsigned int sceneWeight(const std::string& filename) {
+	std::ifstream fileStream(filename, std::ifstream::in | std::ifstream::binary);
+	uint32_t headerSize = 0;
+	HeaderPair bytecode;
+	fileStream.read((char*) &headerSize, 4);
+	readHeaderPair(fileStream, bytecode);
+	if (!fileStream || headerSize != 0x84)
+		return 0;
+	return bytecode.count;
 }
 
+// pFunction is null for the script's own entrypoints
+static void decompileFunction(const InstructionTable& instructions, const ScriptInfo& info, const Function* pFunction, bool dumpAsm, FunctionOutput& output) {
+	// Opened first so every node of the function is gone before it closes
+	Arena::Scope arena;
+	std::ostringstream outStream;
+	BytecodeParser parser(instructions);
+	// Only what this function parses
+	FlightRecorder& recorder = FlightRecorder::local();
+	recorder.clear();
 
+	try {
+		std::vector<unsigned int> entrypoints = pFunction ? std::vector<unsigned int>({pFunction->address}) : info.getEntrypoints();
+		// TODO: implement an actual way to copy assign cfg
+		ControlFlowGraph cfg(parser, entrypoints);
 
-int Logger::LogLevel = Logger::LEVEL_INFO;
-int main(int argc, char* argv[]) {
-	extern char *optarg;
-	extern int optind;
-	
-	std::string outFilename;
-	static char usageString[] = "Usage: decompiless [-o outfile] [-v] [-i file index] [-d] <input.ss>";
+		if (pFunction)
+			Logger::Info() << "Parsing function " << pFunction->name << " (0x" << toHex(pFunction->address, parser.addressWidth) << ")\n";
+		parser.parse(cfg, info, dumpAsm ? &output.asmRecords : nullptr);
 
-	int fileIndex = -1;
-	bool dumpAsm = false;
-	// Handle options
-	int option = 0;
-	while ((option = getopt(argc, argv, "o:vi:d")) != -1) {
-		switch (option) {
-		case 'v':
-			Logger::increaseVerbosity();
-			break;
-		case 'o':
-			outFilename = std::string(optarg);
-		break;
-		case 'i':
-			fileIndex = std::stoi(optarg);
-		break;
-		case 'd':
-			dumpAsm = true;
-		break;
-		default:
-			std::cout << usageString << std::endl;
-			return 1;
+		cfg.structureStatements();
+
+		if (pFunction) {
+			outStream << "\nfn " << pFunction->name << parser.getFunctionSignature() << " {\n";
+			cfg.printBlocks(outStream, 1);
+			outStream << "}\n";
+		} else {
+			cfg.printBlocks(outStream);
 		}
+	} catch (std::exception &e) {
+		// Anything, even running out of memory, only fails this function
+		output.error = e.what();
+	} catch (...) {
+		output.error = "Unknown error";
 	}
-	
-	if (optind >= argc) {
-		std::cout << usageString << std::endl;
-		return 1;
+	if (!output.error.empty()) {
+		int line = parser.getLine(parser.instAddress);
+		if (line >= 0)
+			output.error += " (near line " + std::to_string(line) + ")";
+		// Most likely why it fell over
+		if (parser.numBadEntries > 0)
+			output.error += " (after " + std::to_string(parser.numBadEntries) + " inconsistent stack heights)";
 	}
-	std::cout << std::setfill('0');
-	
-	std::string filename(argv[optind]);
+	output.numTemporaries = parser.getNumTemporaries();
+	output.diagnostics = std::move(parser.diagnostics);
+	if (!output.error.empty() || output.diagnostics.hasErrors())
+		output.trace = recorder.snapshot();
+
+	output.source = outStream.str();
+}
+
+Scene::Scene(const std::string& filename, const GlobalInfo& global, int fileIndex, bool dumpAsm_) : dumpAsm(dumpAsm_) {
+	name = filename.substr(filename.find_last_of("/\\") + 1);
+	Logger::Context context(name);
 	std::ifstream fileStream(filename, std::ifstream::in | std::ifstream::binary);
-	if (!fileStream.is_open()) {
-		Logger::Error() << "Could not open file " << filename;
-		return 1;
-	}
-	
-	if (outFilename.empty())
-		outFilename = filename + ".src";
-	
-	// Start reading stuff
+	if (!fileStream.is_open())
+		throw std::runtime_error("Could not open file " + filename);
 
-	// Read script header
-	ScriptHeader header;
 	readScriptHeader(fileStream, header);
+	readBytecode(fileStream, header.bytecode, bytecode);
+	pInstructions = make_unique<InstructionTable>(bytecode.data(), bytecode.size());
+	pInfo = make_unique<ScriptInfo>(fileStream, header, global, fileIndex, filename);
 
-	BytecodeParser parser(fileStream, header.bytecode);
+	functions = pInfo->getFunctionAddresses();
+	for (unsigned int i = 0; i < numTasks(); i++)
+		tasks.push_back(make_unique<Task>());
+}
 
-	ScriptInfo info(fileStream, header, fileIndex, filename);
-	std::ofstream outStream(outFilename);
+Scene::~Scene() {}
 
-	// TODO: implement an actual way to copy assign cfg
-	ControlFlowGraph mainCFG(parser, info.getEntrypoints());
-	
+unsigned char Scene::getAddressWidth() const {
+	return BytecodeParser::getAddressWidth(bytecode.size());
+}
 
-	std::map<unsigned int, std::string> asmLines;
-	std::map<unsigned int, std::string>* pAsmLines = dumpAsm ? &asmLines : nullptr;
-	try {
-		parser.parse(mainCFG, info, pAsmLines);
+const FunctionOutput& Scene::decompile(unsigned int task) {
+	Task& t = *tasks.at(task);
+	std::call_once(t.once, [this, task, &t]() {
+		std::ostringstream log;
+		{
+			Logger::Redirect redirect(log);
+			Logger::Context context((task == 0) ? name : name + ":" + functions[task - 1].name.str());
+			decompileFunction(*pInstructions, *pInfo, (task == 0) ? nullptr : &functions[task - 1], dumpAsm, t.output);
+			t.output.diagnostics.print();
+		}
+		t.output.log = log.str();
+	});
+	return t.output;
+}
 
-		mainCFG.structureStatements();
+std::string numberTemporaries(const std::string& text, unsigned int first) {
+	size_t mark = text.find(TEMPORARY_MARK);
+	if (mark == std::string::npos)
+		return text;
 
-		mainCFG.printBlocks(outStream);
+	std::string numbered;
+	size_t pos = 0;
+	for (; mark != std::string::npos; mark = text.find(TEMPORARY_MARK, pos)) {
+		size_t end = text.find(TEMPORARY_MARK, mark + 1);
+		if (end == std::string::npos)
+			break;
+		// Not one of ours unless there is a number between the two
+		if (end == mark + 1 || text.find_first_not_of("0123456789", mark + 1) != end) {
+			numbered.append(text, pos, mark + 1 - pos);
+			pos = mark + 1;
+			continue;
+		}
+		numbered.append(text, pos, mark - pos);
+		numbered += std::to_string(first + std::stoul(text.substr(mark + 1, end - mark - 1)));
+		pos = end + 1;
+	}
+	numbered.append(text, pos, std::string::npos);
+	return numbered;
+}
 
-		auto fns = info.getFunctionAddresses();
+unsigned int Scene::decompileAll(ThreadPool* pool) {
+	if (pool != nullptr) {
+		pool->parallelFor(numTasks(), [this](unsigned int i) {
+			decompile(i);
+		});
+	}
 
-		for (const auto& fn:fns) {
-			ControlFlowGraph cfg(parser, {fn.address});
+	// A serial run stops at the first error, so stop there either way
+	for (unsigned int i = 0; i < numTasks(); i++) {
+		if (!decompile(i).error.empty())
+			return i + 1;
+	}
+	return numTasks();
+}
+
+// Reads the argument types of a call the same way getArgs does, nested lists first
+static unsigned int readArgTypes(const InstructionTable& table, unsigned int& n, TypeList& argTypes) {
+	unsigned int numArgs = table.getOperand(n++);
+	for (unsigned int i = 0; i < numArgs; i++) {
+		unsigned int type = table.getOperand(n++);
+		if (type == 0xFFFFFFFF)
+			argTypes.push_back(readArgTypes(table, n, argTypes));
+		argTypes.push_back(type);
+	}
+	return numArgs;
+}
 
-			Logger::Info() << "Parsing function " << fn.name << " (0x" << toHex(fn.address, parser.addressWidth) << ")\n";
-			parser.parse(cfg, info, pAsmLines);
+static std::string printInstruction(const InstructionTable& instructions, const ScriptInfo& info, const AsmRecord& record, unsigned char addressWidth) {
+	if (record.kind == AsmRecord::UNMAPPED)
+		return "unmapped";
+	if (record.kind == AsmRecord::BLANK)
+		return "";
 
-			cfg.structureStatements();
+	// The parser got through it, so it decodes in full
+	const InstructionTable* pTable = &instructions;
+	InstructionTable odd(instructions.getBytecode(), instructions.getLength(), false);
+	unsigned int inst = instructions.find(record.address);
+	if (inst == InstructionTable::NONE) {
+		pTable = &odd;
+		inst = odd.decode(record.address);
+	}
+	const InstructionTable& table = *pTable;
+	unsigned int n = table.operandsBegin(inst);
+
+	unsigned char opcode = table.getOpcode(inst);
+	const OpcodeInfo& opcodeInfo = getOpcodeInfo(opcode);
+	if (opcodeInfo.mnemonic == nullptr)
+		return "[" + toHex(opcode, 2) + "]";
+	std::string line = opcodeInfo.mnemonic;
+
+	// The few that don't print the way their operands say
+	switch (opcode) {
+		case 0x02: {
+			unsigned int type = table.getOperand(n);
+			unsigned int value = table.getOperand(n + 1);
+			if (type == ValueType::STR)
+				return line + " " + VarType(type) + " \"" + info.getString(value) + "\"";
+		} break;
+		case 0x15: {
+			TypeList retTypes;
+			if (readArgTypes(table, n, retTypes) > 0)
+				line += printArgList(retTypes);
+			return line;
+		}
+		case 0x21:
+			return line + " " + VarType(table.getOperand(n)) + " 0x" + toHex(table.getOperand(n + 1));
+		case 0x30: {
+			line += " " + std::to_string(table.getOperand(n++)) + " ";
+			TypeList argTypes;
+			readArgTypes(table, n, argTypes);
+			line += printArgList(argTypes);
+
+			unsigned int numExtra = table.getOperand(n++);
+			if (numExtra > 0) {
+				line += "(";
+				for (unsigned int i = 0; i < numExtra; i++)
+					line += "0x" + toHex(table.getOperand(n++));
+				line += ")";
+			}
+			unsigned int returnType = table.getOperand(n);
+			if (returnType != ValueType::VOID)
+				line += " → " + VarType(returnType);
+			if (record.hasExtra)
+				line += " <0x" + toHex(record.extra) + ">";
+			return line;
+		}
+	}
 
-			outStream << "\nfn " << fn.name << parser.getFunctionSignature() << " {\n";
-			cfg.printBlocks(outStream, 1);
-			outStream << "}\n";
+	for (const char* pOperand = opcodeInfo.operands; *pOperand; pOperand++) {
+		switch (*pOperand) {
+			case 'i':
+				line += " " + std::to_string(table.getOperand(n++));
+			break;
+			case 'x':
+				line += " 0x" + toHex(table.getOperand(n++));
+			break;
+			case 't':
+				line += " " + VarType(table.getOperand(n++));
+			break;
+			case 'l':
+				line += " 0x" + toHex(info.getLabelAddress(table.getOperand(n++)), addressWidth);
+			break;
+			case 'v':
+				line += " " + info.getLocalVarName(table.getOperand(n++));
+			break;
+			case 'c':
+				line += " 0x" + toHex(table.getOperand(n++), 2);
+			break;
+			case 'a': {
+				TypeList argTypes;
+				readArgTypes(table, n, argTypes);
+				line += printArgList(argTypes);
+			} break;
+			case 'n': {
+				unsigned int count = table.getOperand(n++);
+				line += " (";
+				for (unsigned int i = 0; i < count; i++)
+					line += ((i > 0) ? " 0x" : "0x") + toHex(table.getOperand(n++));
+				line += ")";
+			} break;
+		}
+	}
+	return line;
+}
 
-		}	
+void Scene::writeAsm(std::ostream& out, unsigned int count, unsigned int start, unsigned int end) {
+	std::vector<const AsmRecord*> records;
+	for (unsigned int i = 0; i < count; i++) {
+		for (const auto& record:decompile(i).asmRecords) {
+			if (record.address >= start && record.address <= end)
+				records.push_back(&record);
+		}
+	}
+	// Stable, so the last function to see an address decides its line
+	std::stable_sort(records.begin(), records.end(), [](const AsmRecord* a, const AsmRecord* b) {
+		return a->address < b->address;
+	});
 
-	} catch (std::logic_error &e) {
-		std::cerr << e.what() << std::endl;
+	unsigned char addressWidth = getAddressWidth();
+	for (auto it = records.begin(); it != records.end();) {
+		const AsmRecord* pChosen = nullptr;
+		unsigned int address = (*it)->address;
+		for (; it != records.end() && (*it)->address == address; it++) {
+			if ((*it)->kind != AsmRecord::UNMAPPED || pChosen == nullptr)
+				pChosen = *it;
+		}
+		out << "0x" << toHex(address, addressWidth) << "\t" << printInstruction(*pInstructions, *pInfo, *pChosen, addressWidth) << "\n";
 	}
+}
 
-	if (dumpAsm) {
-		std::ofstream dumpStream(filename + ".asm");
-		Logger::Info() << "Dumping assembler to " << filename << ".asm" << "\n";
-		for (const auto& line:asmLines)
-			dumpStream << "0x" << toHex(line.first, parser.addressWidth) << "\t" << line.second << "\n";
+std::string sideFileName(const std::string& outFilename, const std::string& extension) {
+	size_t length = outFilename.size();
+	if (length >= 4 && outFilename.compare(length - 4, 4, ".src") == 0)
+		return outFilename.substr(0, length - 4) + extension;
+	return outFilename + extension;
+}
+
+std::string decompileScene(const std::string& filename, const std::string& outFilename, const GlobalInfo& global, const DecompileOptions& options) {
+	Scene scene(filename, global, options.fileIndex, options.dumpAsm);
+	std::ofstream outStream(outFilename);
+
+	// The script itself first, then its functions, put back together in order
+	unsigned int numDone = scene.decompileAll(options.pool);
+	Logger::Context context(filename.substr(filename.find_last_of("/\\") + 1));
+	std::string error;
+	DiagnosticLog diagnostics;
+	// Temporaries go on from the ones before, in task order, like a serial run
+	unsigned int firstTemporary = 0;
+	for (unsigned int i = 0; i < numDone; i++) {
+		const FunctionOutput& output = scene.decompile(i);
+		Logger::Forward(numberTemporaries(output.log, firstTemporary));
+		outStream << numberTemporaries(output.source, firstTemporary);
+		firstTemporary += output.numTemporaries;
+		error = output.error;
+		diagnostics.merge(output.diagnostics);
+	}
+
+	if (!diagnostics.empty())
+		Logger::Warn() << filename << ": " << diagnostics.summary() << "\n";
+	if (options.dumpDiagnostics) {
+		std::string diagName = sideFileName(outFilename, ".diag");
+		std::ofstream dumpStream(diagName);
+		Logger::Info() << "Dumping diagnostics to " << diagName << "\n";
+		diagnostics.dump(dumpStream);
+	}
+
+	// Only written when a function went wrong, with the instructions it parsed last
+	std::string traceName = sideFileName(outFilename, ".trace");
+	std::ofstream traceStream;
+	for (unsigned int i = 0; i < numDone; i++) {
+		const FunctionOutput& output = scene.decompile(i);
+		if (output.trace.empty())
+			continue;
+		if (!traceStream.is_open()) {
+			traceStream.open(traceName);
+			Logger::Info() << "Dumping trace to " << traceName << "\n";
+		}
+		traceStream << "== " << ((i == 0) ? std::string("(entrypoints)") : scene.getFunctions()[i - 1].name.str()) << ": "
+			<< (output.error.empty() ? output.diagnostics.summary() : output.error) << "\n";
+		writeTrace(traceStream, output.trace);
+	}
+	// Or one from an earlier run would be taken for this one's
+	if (!traceStream.is_open())
+		std::remove(traceName.c_str());
+
+	if (options.dumpAsm) {
+		std::string asmName = sideFileName(outFilename, ".asm");
+		std::ofstream dumpStream(asmName);
+		Logger::Info() << "Dumping assembler to " << asmName << "\n";
+		scene.writeAsm(dumpStream, numDone);
 	}
 
 	//cfg.dumpGraph(filename + ".gv");
 		
 	// TODO: handle these
+	const ScriptHeader& header = scene.getHeader();
+	std::ifstream fileStream(filename, std::ifstream::in | std::ifstream::binary);
 	if (header.unknown6.count != 0) {
 		Logger::Warn() << "Unknown6 has " << header.unknown6.count << " elements.\n";
 
@@ -457,9 +709,9 @@ int main(int argc, char* argv[]) {
 		fileStream.seekg(header.unknown6.offset, std::ios::beg);
 		for (uint32_t i = 0; i < header.unknown6.count; i++) {
 			fileStream.read((char*) &u6, 4);
-			Logger::Debug() << std::to_string(u6) << " ";
+			LOG_DEBUG() << std::to_string(u6) << " ";
 		}
-		Logger::Debug() << std::endl;
+		LOG_DEBUG() << std::endl;
 	}
 	if (header.unknown7.count != 0) {
 		Logger::Warn() << "Unknown7 has " << header.unknown7.count << " elements.\n";
@@ -467,9 +719,224 @@ int main(int argc, char* argv[]) {
 		fileStream.seekg(header.unknown7.offset, std::ios::beg);
 		for (uint32_t i = 0; i < header.unknown7.count; i++) {
 			fileStream.read((char*) &u7, 4);
-			Logger::Debug() << std::to_string(u7) << " ";
+			LOG_DEBUG() << std::to_string(u7) << " ";
 		}
-		Logger::Debug() << std::endl;
+		LOG_DEBUG() << std::endl;
+	}
+
+	return error;
+}
+
+
+// readscene writes SceneInfo.dat into its output directory along with the scenes
+// The one in the working directory still comes first
+static std::string globalInfoName(const std::string& scene) {
+	std::string name("SceneInfo.dat");
+	size_t slash = scene.find_last_of("/\\");
+	if (std::ifstream(name).is_open() || slash == std::string::npos)
+		return name;
+	return scene.substr(0, slash + 1) + name;
+}
+
+// decompiless merge: combine the outputs of a sharded batch
+static int mergeMain(int argc, char* argv[]) {
+	static char usageString[] = "Usage: decompiless merge -o outdir <shard dir>...";
+
+	std::string outDir;
+	int option = 0;
+	while ((option = getopt(argc, argv, "o:v")) != -1) {
+		switch (option) {
+		case 'v':
+			Logger::increaseVerbosity();
+			break;
+		case 'o':
+			outDir = std::string(optarg);
+		break;
+		default:
+			std::cout << usageString << std::endl;
+			return 1;
+		}
+	}
+	if (outDir.empty() || optind >= argc) {
+		std::cout << usageString << std::endl;
+		return 1;
+	}
+
+	try {
+		unsigned int numFailed = mergeBatch(std::vector<std::string>(argv + optind, argv + argc), outDir);
+		return (numFailed > 0) ? 1 : 0;
+	} catch (std::exception&) {
+		// Already logged
+		return 1;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	extern char *optarg;
+	extern int optind;
+
+	if (argc > 1 && std::string(argv[1]) == "merge")
+		return mergeMain(argc - 1, argv + 1);
+	
+	std::string outFilename;
+	static char usageString[] = "Usage: decompiless [-o outfile|outdir] [-v] [-i file index] [-d] [--diagnostics] [--log stdout|stderr|none|file] [-j threads] [-p processes [-t timeout] [-m memory MB]] [--shard i/N] <input.ss|Scene dir>...\n"
+		"       decompiless merge -o outdir <shard dir>...\n"
+		"       decompiless --serve [--socket path] [--cache scenes] [-j threads]";
+
+	DecompileOptions options;
+	bool batch = false;
+	unsigned int numThreads = 1;
+	unsigned int numProcesses = 0;
+	WorkerLimits limits;
+	Shard shard;
+	bool serving = false;
+	std::string logSink;
+	ServeOptions serveOptions;
+	static struct option longOptions[] = {
+		{"shard", required_argument, nullptr, 's'},
+		{"serve", no_argument, nullptr, 'S'},
+		{"socket", required_argument, nullptr, 'U'},
+		{"cache", required_argument, nullptr, 'C'},
+		{"diagnostics", no_argument, nullptr, 'D'},
+		{"log", required_argument, nullptr, 'L'},
+		{nullptr, 0, nullptr, 0}
+	};
+	// Handle options
+	int option = 0;
+	while ((option = getopt_long(argc, argv, "o:vi:dj:p:t:m:", longOptions, nullptr)) != -1) {
+		switch (option) {
+		case 'v':
+			Logger::increaseVerbosity();
+			break;
+		case 'o':
+			outFilename = std::string(optarg);
+		break;
+		case 'i':
+			options.fileIndex = std::stoi(optarg);
+		break;
+		case 'd':
+			options.dumpAsm = true;
+		break;
+		case 'j':
+			numThreads = std::stoi(optarg);
+			serveOptions.numThreads = numThreads;
+		break;
+		case 'p':
+			numProcesses = std::stoi(optarg);
+		break;
+		case 't':
+			limits.timeoutSeconds = std::stoi(optarg);
+		break;
+		case 'm':
+			limits.memoryMegabytes = std::stoi(optarg);
+		break;
+		case 's':
+			if (!shard.parse(optarg)) {
+				Logger::Error() << "Bad shard " << optarg << ", expected i/N with 0 <= i < N\n";
+				return 1;
+			}
+		break;
+		case 'S':
+			serving = true;
+		break;
+		case 'U':
+			serveOptions.socketPath = std::string(optarg);
+		break;
+		case 'C':
+			serveOptions.cacheSize = std::stoi(optarg);
+		break;
+		case 'D':
+			options.dumpDiagnostics = true;
+		break;
+		case 'L':
+			logSink = std::string(optarg);
+		break;
+		default:
+			std::cout << usageString << std::endl;
+			return 1;
+		}
+	}
+	
+	if ((limits.timeoutSeconds > 0 || limits.memoryMegabytes > 0) && numProcesses == 0) {
+		Logger::Error() << "-t and -m only apply to worker processes, they need -p.\n";
+		return 1;
+	}
+
+	// Keep stdout clean for the answers
+	if (serving && logSink.empty())
+		logSink = "stderr";
+	if (!logSink.empty() && !Logger::setSink(logSink)) {
+		Logger::Error() << "Could not open log file " << logSink << std::endl;
+		return 1;
+	}
+
+	if (serving) {
+		GlobalInfo global;
+		global.read();
+		return serve(global, options, serveOptions);
+	}
+
+	if (optind >= argc) {
+		std::cout << usageString << std::endl;
+		return 1;
+	}
+	std::cout << std::setfill('0');
+
+	std::vector<std::string> inputs(argv + optind, argv + argc);
+	std::vector<std::string> scenes = collectScenes(inputs);
+	if (scenes.size() != 1 || scenes[0] != inputs[0] || numProcesses > 0)
+		batch = true;
+
+	GlobalInfo global;
+	global.read(globalInfoName(scenes.empty() ? inputs[0] : scenes[0]));
+
+	if (shard.count > 1) {
+		// Every shard writes into its own output directory, merged afterwards
+		if (outFilename.empty()) {
+			Logger::Error() << "--shard needs an output directory (-o).\n";
+			return 1;
+		}
+		try {
+			unsigned int numFailed = decompileShard(scenes, shard, outFilename, global, options, numThreads, numProcesses, limits);
+			return (numFailed > 0) ? 1 : 0;
+		} catch (std::exception&) {
+			return 1;
+		}
+	}
+
+	if (batch) {
+		// -o names a directory for the outputs
+		try {
+			unsigned int numFailed;
+			if (numProcesses > 0)
+				numFailed = decompileBatchIsolated(scenes, outFilename, global, options, numProcesses, limits);
+			else
+				numFailed = decompileBatch(scenes, outFilename, global, options, numThreads);
+			return (numFailed > 0) ? 1 : 0;
+		} catch (std::exception&) {
+			return 1;
+		}
+	}
+	
+	std::string filename(argv[optind]);
+	if (outFilename.empty())
+		outFilename = filename + ".src";
+
+	// Functions of a single scene are spread over the threads
+	std::unique_ptr<ThreadPool> pPool;
+	if (numThreads != 1) {
+		pPool = make_unique<ThreadPool>(numThreads);
+		options.pool = pPool.get();
+	}
+
+	try {
+		std::string error = decompileScene(filename, outFilename, global, options);
+		if (!error.empty())
+			std::cerr << error << std::endl;
+	} catch (std::exception& e) {
+		// Some are logged already, but not all (a bad index in the scene info, say)
+		Logger::Error() << e.what() << std::endl;
+		return 1;
 	}
 			
 	return 0;
@@ -477,21 +944,17 @@ int main(int argc, char* argv[]) {
 
 
 
-BytecodeParser::BytecodeParser(std::ifstream &f, HeaderPair index) {
-	f.seekg(index.offset, std::ios_base::beg);
-	buf = new BytecodeBuffer(f, index.count);
+BytecodeParser::BytecodeParser(const InstructionTable& instructions_) : instructions(instructions_), oddInstructions(instructions_.getBytecode(), instructions_.getLength(), false) {
+	addressWidth = getAddressWidth(instructions.getLength());
+}
 
-	unsigned int ll = index.count;
+unsigned char BytecodeParser::getAddressWidth(unsigned int length) {
 	unsigned char w = 1;
-	while (ll > 0) {
-		ll /= 0x10;
+	while (length > 0) {
+		length /= 0x10;
 		w++;
 	}
-	addressWidth = (w / 2) * 2;
-}
-
-BytecodeParser::~BytecodeParser() {
-	delete buf;
+	return (w / 2) * 2;
 }
 
 struct ProgBranch {
@@ -501,16 +964,25 @@ struct ProgBranch {
 };
 
 
+// Each block is parsed once, with the stack it was first queued with
+// Reaching it again (another jump, a fall through) with a different stack is ignored,
+// so the first path to a block decides what its expressions look like
 void BytecodeParser::addBranch(Block* pBlock, Stack* saveStack) {
 	if (pBlock == nullptr)
 		throw std::logic_error("Null block");
+	// Functions get whatever the caller has on its stack, so don't hold them to one height
+	if (!pBlock->isFunction)
+		checkEntry(pBlock, saveStack ? *saveStack : Stack());
 	if (pBlock->parsed)
 		return;
-	for (const auto &branch:toTraverse) {
-		// Operate under assumption block pointers will be unique
-		if (branch.pBlock == pBlock)
-			return;
-	}
+
+	// A block stays marked once it is popped, since it is parsed by then
+	unsigned int index = pBlock->index;
+	if (index >= queuedBlocks.size())
+		queuedBlocks.resize(index + 1, false);
+	if (queuedBlocks[index])
+		return;
+	queuedBlocks[index] = true;
 
 	toTraverse.push_back(ProgBranch(pBlock));
 
@@ -520,15 +992,43 @@ void BytecodeParser::addBranch(Block* pBlock, Stack* saveStack) {
 	}
 }
 
+// Reports a way into a block with different stack heights from the first one seen
+// Only the first gets parsed, so anything left on (or missing from) the others' stacks is lost or popped past the end
+void BytecodeParser::checkEntry(const BasicBlock* pBlock, const Stack& entryStack) {
+	unsigned int index = pBlock->index;
+	if (index >= blockEntries.size())
+		blockEntries.resize(index + 1);
+
+	BlockEntry& entry = blockEntries[index];
+	const std::vector<unsigned int>& heights = entryStack.getHeights();
+	if (entry.heights.empty()) {
+		entry.heights = heights;
+		entry.from = instAddress;
+		return;
+	}
+	if (entry.heights == heights)
+		return;
+
+	numBadEntries++;
+	auto printHeights = [](const std::vector<unsigned int>& list) {
+		std::string str;
+		for (const auto& height:list)
+			str += (str.empty() ? "" : "/") + std::to_string(height);
+		return str;
+	};
+	diagnostics.add(Diagnostic::BAD_ENTRY, instAddress, printHeights(heights) + " here, " + printHeights(entry.heights) + " from 0x" + toHex(entry.from), index);
+}
+
 Value BytecodeParser::getArg(unsigned int type, const ScriptInfo &info) {
 	if (stack.empty()) {
-		return make_unique<ErrValueExpr>("Popping arguments off an empty stack.", instAddress);
+		diagnostics.add(Diagnostic::EMPTY_ARGS, instAddress);
+		return make_unique<ErrValueExpr>();
 	}
 
 	unsigned int actualType = stack.back()->getType();
 	if (type == ValueType::INT || type == ValueType::STR) {
 		if (actualType != type)
-			Logger::Error(instAddress) << "Expected arg: " << VarType(type) << ", got " << VarType(actualType) << std::endl;
+			diagnostics.add(Diagnostic::ARG_TYPE, instAddress, type, actualType);
 		return stack.pop();
 	}
 	// Yeah I'll just do this
@@ -537,12 +1037,12 @@ Value BytecodeParser::getArg(unsigned int type, const ScriptInfo &info) {
 	return Value(arg);
 }
 
-unsigned int BytecodeParser::getArgs(std::vector<Value> &args, std::vector<unsigned int> &argTypes, const ScriptInfo& info) {
+unsigned int BytecodeParser::getArgs(ValueList &args, TypeList &argTypes, const ScriptInfo& info) {
 	unsigned int numArgs = getInt();
 	for (unsigned int i = 0; i < numArgs; i++) {
 		unsigned int type = getInt();
 		if (type == 0xFFFFFFFF) {
-			std::vector<Value> list;
+			ValueList list;
 			argTypes.push_back(getArgs(list, argTypes, info));
 			args.push_back(make_unique<ListExpression>(std::move(list)));
 		} else {
@@ -555,8 +1055,10 @@ unsigned int BytecodeParser::getArgs(std::vector<Value> &args, std::vector<unsig
 
 
 Value BytecodeParser::getLocalVar(unsigned int index) {
-	if (index >= localVars.size())
-		return make_unique<ErrValueExpr>("Local var index " + std::to_string(index) + " out of range.", instAddress);
+	if (index >= localVars.size()) {
+		diagnostics.add(Diagnostic::LOCAL_VAR_RANGE, instAddress, index);
+		return make_unique<ErrValueExpr>();
+	}
 
 	return Value(localVars[index]->clone());
 }
@@ -577,14 +1079,17 @@ std::string BytecodeParser::getFunctionSignature() {
 
 // Not too sure where this belongs
 Expression* BytecodeParser::getLValue(const ScriptInfo &info) {
-	auto curr = stack.getFrame();
+	if (stack.height() == 0) {
+		diagnostics.add(Diagnostic::NO_ELEMENT_CODE, instAddress);
+		return new ErrValueExpr();
+	}
+
+	std::vector<Value> frame = stack.takeFrame();
+	auto curr = frame.begin();
 	Value pCurr, pLast;
 	bool localVar = false, indexing = false;
 	std::string localString = "g_";
 
-	if (curr == stack.end())
-		return new ErrValueExpr("Cannot pop element code - stack empty!", instAddress);
-
 	unsigned int index = (*curr)->getIndex();
 	// Not right, only 0x25 and 0x26 are indices
 	// 0x53 => 0x00, 0x01, 0x7d, 0x7f
@@ -596,7 +1101,7 @@ Expression* BytecodeParser::getLValue(const ScriptInfo &info) {
 	}
 
 
-	while (curr != stack.end()) {
+	while (curr != frame.end()) {
 		pCurr = std::move(*curr);
 
 		if (pCurr->getType() != ValueType::INT) {
@@ -610,7 +1115,7 @@ Expression* BytecodeParser::getLValue(const ScriptInfo &info) {
 				if (indexing) {
 					indexing = false;
 					pLast = make_unique<IndexValueExpr>(std::move(pLast), std::move(pCurr));
-					Logger::VVDebug(instAddress) << "Created index reference " << pLast->print(true) << "\n";
+					LOG_VVDEBUG(instAddress) << "Created index reference " << pLast->print(true) << "\n";
 				} else {
 					if (pLast == nullptr || pLast->getType() == ValueType::STAGE_ELEMENT) {
 						unsigned int type;
@@ -626,28 +1131,28 @@ Expression* BytecodeParser::getLValue(const ScriptInfo &info) {
 							type = ValueType::INT_LIST;
 						}
 						pLast = make_unique<VariableExpression>(localString + pCurr->print(true), type, 1);
-						Logger::VVDebug(instAddress) << "Created array " << pLast->print(true) << "\n";
+						LOG_VVDEBUG(instAddress) << "Created array " << pLast->print(true) << "\n";
 					} else {
 						pLast = make_unique<MemberExpr>(std::move(pLast), std::move(pCurr));
-						Logger::VVDebug(instAddress) << "Created member access " << pLast->print(true) << "\n";
+						LOG_VVDEBUG(instAddress) << "Created member access " << pLast->print(true) << "\n";
 					}
 				}
 			} break;
 			case IntegerLocalVar: {
 				if (!localVar)
-					Logger::Warn(instAddress) << "Getting local var without local reference.\n";
+					diagnostics.add(Diagnostic::LOCAL_WITHOUT_REF, instAddress);
 
-				if (pLast != nullptr && pLast->getType() != ValueType::STAGE_ELEMENT)	Logger::Warn(instAddress) << "Overwriting variable.\n";
+				if (pLast != nullptr && pLast->getType() != ValueType::STAGE_ELEMENT)	diagnostics.add(Diagnostic::OVERWRITING_VAR, instAddress);
 				unsigned int index2 = pCurr->getIndex();
 				pLast = getLocalVar(index2);
 
-				Logger::VDebug(instAddress) << pLast->print() << ": " << VarType(pLast->getType()) << std::endl;
+				LOG_VDEBUG(instAddress) << pLast->print() << ": " << VarType(pLast->getType()) << std::endl;
 			} break;
 			case IntegerGlobalVar: {
 				if (localVar)
-					Logger::Warn(instAddress) << "Getting global var with local reference.\n";
+					diagnostics.add(Diagnostic::GLOBAL_WITH_REF, instAddress);
 
-				if (pLast != nullptr)	Logger::Warn(instAddress) << "Overwriting variable.\n";
+				if (pLast != nullptr)	diagnostics.add(Diagnostic::OVERWRITING_VAR, instAddress);
 				pLast = info.getGlobalVar(pCurr->getIndex());
 			} break;
 			case IntegerIndexer:
@@ -664,13 +1169,12 @@ Expression* BytecodeParser::getLValue(const ScriptInfo &info) {
 		throw std::logic_error("0x" + toHex(instAddress) + ": Something went horribly wrong.");
 	}
 
-	stack.closeFrame();
 	return pLast->clone(); // think about whether this is needed, or maybe I could just release/pass directly back (i forget how this is used)
 }
 
 FunctionExpr* BytecodeParser::getCallFunction(const ScriptInfo& info) {
 	if (stack.height() == 0) {
-		Logger::Error(instAddress) << "Empty function!\n";
+		diagnostics.add(Diagnostic::EMPTY_FUNCTION, instAddress);
 		return new FunctionExpr("FN_ERROR");
 	} else if (stack.height() == 1) {
 		Value pCall = stack.pop();
@@ -705,11 +1209,12 @@ FunctionExpr* BytecodeParser::getCallFunction(const ScriptInfo& info) {
 	return new FunctionExpr(Value(getLValue(info)));
 }
 
-void BytecodeParser::parse(ControlFlowGraph& cfg, ScriptInfo& info, std::map<unsigned int, std::string> *pAsmLines) {
-	std::string asmLine;
-	bool dumpAsm = pAsmLines != nullptr;
+void BytecodeParser::parse(ControlFlowGraph& cfg, const ScriptInfo& info, std::vector<AsmRecord> *pAsm) {
+	bool dumpAsm = pAsm != nullptr;
+	FlightRecorder& recorder = FlightRecorder::local();
 
 	numParams = 0;
+	numTemporaries = 0;
 	bool paramsDone = false;
 	localVars.clear();
 	while (!toTraverse.empty()) {
@@ -720,81 +1225,81 @@ void BytecodeParser::parse(ControlFlowGraph& cfg, ScriptInfo& info, std::map<uns
 		if (pBlock->parsed)
 			continue;
 
-		buf->setAddress(pBlock->startAddress);
+		nextAddress = pBlock->startAddress;
 		stack = std::move(branch.stack);
 		pBlock->parsed = true;
 
-		Logger::VVDebug(instAddress) << "Parsing new branch - starting at block " << std::to_string(pBlock->index) << std::endl;
+		LOG_VVDEBUG(instAddress) << "Parsing new branch - starting at block " << std::to_string(pBlock->index) << std::endl;
 
 		unsigned char opcode;
 		Statement* pStatement;
 		bool newBlock = false;
 
-		while (!buf->done()) {
-			instAddress = buf->getAddress();
-			opcode = getChar();
+		while (nextAddress != instructions.getLength()) {
+			instAddress = nextAddress;
+			opcode = fetch(instAddress);
+			recorder.record(instAddress, opcode, stack.height(), pBlock->index);
 
 			pStatement = nullptr;
-			asmLine = "";
+			// Only turned into text if the assembler is written out
+			AsmRecord record(instAddress);
 			switch (opcode) {
 				case 0x01: {
 					unsigned int lineNum = getInt();
-					pStatement = new LineNumStatement(lineNum);
-					asmLine = "line " + std::to_string(lineNum);
+					addLine(instAddress, lineNum);
+					// Two in a row leave the first on its own
+					flushLine(pBlock);
+					pendingLine = lineNum;
 				} break;
 				case 0x02: {
 					unsigned int type = getInt();
 					unsigned int value = getInt();
 
-					asmLine = "push " + VarType(type);
 					if (type == ValueType::STR) {
 						std::string str = info.getString(value);
 						stack.push(new RawValueExpr(str, value));
-						asmLine += " \"" + str + "\"";
 					} else {
 						stack.push(new RawValueExpr(type, value));
-						asmLine += " 0x" + toHex(value);
 					}
 				} break; 
 				case 0x03: {
 					unsigned int type = getInt();
 					if (type == ValueType::INT || type == ValueType::STR) {
 						Value back = stack.pop();
-						if (back->getType() != type) {
-							Logger::Error(instAddress) << "Expected type " << VarType(type) << ", got type " << VarType(back->getType()) << std::endl;
-						}
+						if (back->getType() != type)
+							diagnostics.add(Diagnostic::POP_TYPE, instAddress, type, back->getType());
 						// Turn into a statement if it has side effects
 						if (back->hasSideEffect()) {
 							pStatement = new ExpressionStatement(back.release());
 						}
 					} else if (type != ValueType::VOID) {
-						Logger::Error(instAddress) << "Cannot pop " << VarType(type) << std::endl;
+						diagnostics.add(Diagnostic::CANNOT_POP, instAddress, type);
 					}
-					asmLine = "pop " + VarType(type);
 				} break;
 				case 0x04: {
 					unsigned int type = getInt();
 					if (stack.empty()) {
-						Logger::Error(instAddress) << "Duplicating empty stack.\n";
+						diagnostics.add(Diagnostic::DUP_EMPTY, instAddress);
+						record.kind = AsmRecord::BLANK;
 						break;
 					}
-					Value& pValue = stack.back();
+					const Expression* pValue = stack.back();
 					if (pValue->getType() != type) {
-						Logger::Error(instAddress) << "Dup - Expected type " << VarType(type) << ", got type " << VarType(pValue->getType()) << std::endl;
-						stack.push(new ErrValueExpr(pValue->print(), instAddress));
+						diagnostics.add(Diagnostic::DUP_TYPE, instAddress, type, pValue->getType());
+						stack.push(new ErrValueExpr());
+						record.kind = AsmRecord::BLANK;
 						break;
 					}
 
 					// Move the value into a variable if it has side effects
 					if (pValue->hasSideEffect()) {
-						Expression* pVar = new VariableExpression(pValue->getType());
+						// Numbered for the whole scene once every function is done, see numberTemporaries
+						Expression* pVar = new VariableExpression("var" + std::string(1, TEMPORARY_MARK) + std::to_string(numTemporaries++) + TEMPORARY_MARK, pValue->getType());
 						stack.push(pVar->clone());
 						pStatement = new AssignStatement(Value(pVar), stack.pop());
 					} else {
 						stack.push(pValue->clone());
 					}
-
-					asmLine = "dup " + VarType(type);
 				} break;
 				case 0x05: {
 					// NOTE: maybe can change getLValue
@@ -808,11 +1313,9 @@ void BytecodeParser::parse(ControlFlowGraph& cfg, ScriptInfo& info, std::map<uns
 						stack.openFrame();
 
 					stack.push(val);
-					asmLine = "eval";
 				} break;
 				case 0x06: {
 					stack.duplicateElement();
-					asmLine = "dup element";
 				} break; 
 				case 0x07: {
 					// TODO: support intlist and strlist
@@ -826,7 +1329,8 @@ void BytecodeParser::parse(ControlFlowGraph& cfg, ScriptInfo& info, std::map<uns
 						Value pLength = stack.pop();
 						unsigned int index = pLength->getIndex();
 						if (index & 0xFF000000) {
-							localVars.push_back(make_unique<ErrValueExpr>("Length for " + name + " is " + pLength->print(), instAddress));
+							diagnostics.add(Diagnostic::LIST_LENGTH, instAddress, name + " is " + pLength->print());
+							localVars.push_back(make_unique<ErrValueExpr>());
 						} else {
 							localVars.push_back(make_unique<VariableExpression>(name, type, index));
 						}
@@ -836,16 +1340,13 @@ void BytecodeParser::parse(ControlFlowGraph& cfg, ScriptInfo& info, std::map<uns
 
 					if (paramsDone)
 						pStatement = new DeclareVarStatement(type, name);
-					asmLine = "var " + VarType(type) + " " + name;
 				} break;
 				case 0x08: {
 					stack.openFrame();
-					asmLine = "frame";
 				} break; 
 				case 0x09: {
 					numParams = localVars.size();
 					paramsDone = true;
-					asmLine = "endparams";
 				} break;
 				case 0x10: {
 					unsigned int labelIndex = getInt();
@@ -853,11 +1354,9 @@ void BytecodeParser::parse(ControlFlowGraph& cfg, ScriptInfo& info, std::map<uns
 
 					pStatement = new GotoStatement(pJumpBlock->index);
 
-					pBlock->nextAddress = buf->getAddress();
-					buf->setAddress(pJumpBlock->startAddress);
+					pBlock->nextAddress = nextAddress;
+					nextAddress = pJumpBlock->startAddress;
 					newBlock = true;
-
-					asmLine = "jmp 0x" + toHex(buf->getAddress(), addressWidth); 
 				} break; 
 				case 0x11: 
 				case 0x12: {
@@ -873,17 +1372,13 @@ void BytecodeParser::parse(ControlFlowGraph& cfg, ScriptInfo& info, std::map<uns
 					pBlock->addSuccessor(pJumpBlock);
 
 
-					Block* pNextBlock = cfg.getBlock(buf->getAddress());
-					if (opcode == 0x12) {
+					Block* pNextBlock = cfg.getBlock(nextAddress);
+					if (opcode == 0x12)
 						negateCondition(condition);
-						asmLine = "jz 0x" + toHex(pJumpBlock->startAddress, addressWidth); 
-					} else {
-						asmLine = "jnz 0x" + toHex(pJumpBlock->startAddress, addressWidth); 
-					}
 					
 					pStatement = new BranchStatement(pJumpBlock->index, pNextBlock->index, std::move(condition));
 
-					pBlock->nextAddress = buf->getAddress();
+					pBlock->nextAddress = nextAddress;
 					newBlock = true;
 				} break;
 				case 0x13:
@@ -893,57 +1388,50 @@ void BytecodeParser::parse(ControlFlowGraph& cfg, ScriptInfo& info, std::map<uns
 					pCallBlock->isFunction = true;
 					pBlock->calls.push_back(pCallBlock);
 
-					std::vector<unsigned int> argTypes;
-					std::vector<Value> args;
+					TypeList argTypes;
+					ValueList args;
 					getArgs(args, argTypes, info);
 
 					addBranch(pCallBlock, &stack);
 
 					stack.push(new ShortCallExpr(pCallBlock->index, std::move(args)));
-
-					asmLine = "gosub 0x" + toHex(pCallBlock->startAddress, addressWidth) + printArgList(argTypes);
 				} break;
 				case 0x15: {
-					std::vector<unsigned int> retTypes;
-					std::vector<Value> ret;
-					unsigned int numArgs = getArgs(ret, retTypes, info);
+					TypeList retTypes;
+					ValueList ret;
+					getArgs(ret, retTypes, info);
 
 					pStatement = new ReturnStatement(std::move(ret));
 
-					pBlock->nextAddress = buf->getAddress();
+					pBlock->nextAddress = nextAddress;
 					newBlock = true;
 
-					if (!stack.empty()) {
-						Logger::Error(instAddress) << "Stack is not empty!\n" << stack.print();
-					}
-
-					asmLine = "ret" + ((numArgs > 0) ? printArgList(retTypes) : "");
+					if (!stack.empty())
+						diagnostics.add(Diagnostic::RETURN_NOT_EMPTY, instAddress, stack.height());
 				} break; 
 				// TODO: handle this properly
 				case 0x16:
 					Logger::Info(instAddress) << "Script end reached.\n";
 					pStatement = new EndScriptStatement();
-					asmLine = "endscript";
 				break;
 				case 0x20: {
 					unsigned int unknown1 = getInt();
 					unsigned int type = getInt();
 					unsigned int unknown2 = getInt();
-					if (unknown2 != 1) {
-						Logger::Warn(instAddress) << "Assigning with " << std::to_string(unknown2) << std::endl;
-					}
+					if (unknown2 != 1)
+						diagnostics.add(Diagnostic::ASSIGN_WITH, instAddress, unknown2);
 
 					Value rhs = stack.pop();
 					Value lhs = Value(getLValue(info));
 
 					if (rhs->getType() != type) {
-						rhs = make_unique<ErrValueExpr>("Assign - Expected type " + VarType(type) + ", got type " + VarType(rhs->getType()), instAddress);
+						diagnostics.add(Diagnostic::ASSIGN_TYPE, instAddress, type, rhs->getType());
+						rhs = make_unique<ErrValueExpr>();
 					}
 
-					Logger::VVDebug(instAddress) << "Assign: " << VarType(unknown1) << " <- " << VarType(type) << std::endl;
+					LOG_VVDEBUG(instAddress) << "Assign: " << VarType(unknown1) << " <- " << VarType(type) << std::endl;
 
 					pStatement = new AssignStatement(std::move(lhs), std::move(rhs));
-					asmLine = "assign " + VarType(unknown1) + " " + VarType(type) + " 0x" + toHex(unknown2);
 				} break;
 				case 0x21: {
 					unsigned int type = getInt();
@@ -951,11 +1439,10 @@ void BytecodeParser::parse(ControlFlowGraph& cfg, ScriptInfo& info, std::map<uns
 
 					Value val = stack.pop();
 					if (val->getType() != type) {
-						val = make_unique<ErrValueExpr>("Calc1 - Expected type " + VarType(type) + ", got type " + VarType(val->getType()), instAddress);
+						diagnostics.add(Diagnostic::CALC1_TYPE, instAddress, type, val->getType());
+						val = make_unique<ErrValueExpr>();
 					}
 					stack.push(new UnaryExpression(std::move(val), op));
-
-					asmLine = "calc1 " + VarType(type) + " 0x" + toHex(op);
 				} break;
 				case 0x22: {
 					unsigned int lhsType = getInt();
@@ -965,24 +1452,25 @@ void BytecodeParser::parse(ControlFlowGraph& cfg, ScriptInfo& info, std::map<uns
 					Value rhs = stack.pop();
 					Value lhs = stack.pop();
 					if (lhs->getType() != lhsType) {
-						lhs = make_unique<ErrValueExpr>("Calc2 - Expected type " + VarType(lhsType) + ", got type " + VarType(lhs->getType()), instAddress);
+						diagnostics.add(Diagnostic::CALC2_TYPE, instAddress, lhsType, lhs->getType());
+						lhs = make_unique<ErrValueExpr>();
 					}
 					if (rhs->getType() != rhsType) {
-						rhs = make_unique<ErrValueExpr>("Calc2 - Expected type " + VarType(rhsType) + ", got type " + VarType(rhs->getType()), instAddress);
+						diagnostics.add(Diagnostic::CALC2_TYPE, instAddress, rhsType, rhs->getType());
+						rhs = make_unique<ErrValueExpr>();
 					}
 
 					stack.push(new BinaryExpression(std::move(lhs), std::move(rhs), op));
-					asmLine = "calc2 " + VarType(lhsType) + " " + VarType(rhsType) + " 0x" + toHex(op, 2);
 				} break; 
 				case 0x30: {
 					unsigned int option = getInt();
 
-					std::vector<unsigned int> argTypes;
-					std::vector<Value> args;
+					TypeList argTypes;
+					ValueList args;
 					getArgs(args, argTypes, info);
 
 					unsigned int numExtra = getInt();
-					std::vector<unsigned int> extraList;
+					TypeList extraList;
 					for (unsigned int i = 0; i < numExtra; i++) {
 						unsigned int u = getInt();
 						extraList.push_back(u);
@@ -992,10 +1480,11 @@ void BytecodeParser::parse(ControlFlowGraph& cfg, ScriptInfo& info, std::map<uns
 
 					// Reversed though
 					FunctionExpr* fn = getCallFunction(info);
-					unsigned int extra = 0;
 					if (fn->hasExtra) {
-						extra = getInt();
+						unsigned int extra = getTrailingInt();
 						fn->extraThing(extra);
+						record.hasExtra = true;
+						record.extra = extra;
 					}
 
 					CallExpr* pCall = new CallExpr(fn, option, std::move(args), extraList, returnType);
@@ -1004,101 +1493,85 @@ void BytecodeParser::parse(ControlFlowGraph& cfg, ScriptInfo& info, std::map<uns
 						pStatement = new ExpressionStatement(pCall);
 					else
 						stack.push(pCall);
-
-					asmLine = "call " + std::to_string(option) + " " + printArgList(argTypes);
-					if (!extraList.empty()) {
-						asmLine += "(";
-						for (const auto& it:extraList)
-							asmLine += "0x" + toHex(it);
-						asmLine += ")";
-					}
-					if (returnType != ValueType::VOID)
-						asmLine += " → " + VarType(returnType);
-					if (fn->hasExtra)
-						asmLine += " <0x" + toHex(extra) + ">";
 				} break;
 				case 0x31: {
 					unsigned int id = getInt();
 					Value pText = stack.pop();
-					if (pText->getType() != ValueType::STR) {
-						Logger::Error(instAddress) << pText->print() << "(" << VarType(pText->getType()) << ") cannot be used to add text.\n";
-					}
+					if (pText->getType() != ValueType::STR)
+						diagnostics.add(Diagnostic::BAD_TEXT, instAddress, pText->print(), pText->getType());
 
 					pStatement = new AddTextStatement(std::move(pText), id);
-					Statement* pLast = pBlock->statements.back();
-					if (pLast->type == Statement::CLEAR_BUFFER) {
+					Statement* pLast = (pendingLine < 0 && !pBlock->statements.empty()) ? pBlock->statements.back() : nullptr;
+					if (pLast && pLast->type == Statement::CLEAR_BUFFER) {
 						if (pLast->getLineNum() >= 0)
 							pStatement->setLineNum(pLast->getLineNum());
 						delete pBlock->statements.back();
 						pBlock->statements.pop_back();
 					} else {
-						Logger::Warn(instAddress) << "No preceding 0x54 call. (is this bad?)\n";
+						diagnostics.add(Diagnostic::NO_CLEARBUF, instAddress);
 					}
-
-					asmLine = "addtext " + std::to_string(id);
 				} break;
 				case 0x32: {
 					Value pName = stack.pop();
-					if (pName->getType() != ValueType::STR) {
-						Logger::Error(instAddress) << pName->print() << "(" << VarType(pName->getType()) << ") cannot be used to set name.\n";
-					}
+					if (pName->getType() != ValueType::STR)
+						diagnostics.add(Diagnostic::BAD_NAME, instAddress, pName->print(), pName->getType());
 
 					pStatement = new SetNameStatement(std::move(pName));
-					Statement* pLast = pBlock->statements.back();
-					if (pLast->type == Statement::CLEAR_BUFFER) {
+					Statement* pLast = (pendingLine < 0 && !pBlock->statements.empty()) ? pBlock->statements.back() : nullptr;
+					if (pLast && pLast->type == Statement::CLEAR_BUFFER) {
 						if (pLast->getLineNum() >= 0)
 							pStatement->setLineNum(pLast->getLineNum());
 						delete pBlock->statements.back();
 						pBlock->statements.pop_back();
 					} else {
-						Logger::Warn(instAddress) << "No preceding 0x54 call. (is this bad?)\n";
+						diagnostics.add(Diagnostic::NO_CLEARBUF, instAddress);
 					}
-
-					asmLine = "setname";
 				} break;
 				default: {
-					Logger::Error(instAddress) << "NOP: 0x" << toHex(opcode, 2) << std::endl;
-					asmLine = "[" + toHex(opcode, 2) + "]";
+					diagnostics.add(Diagnostic::UNKNOWN_OPCODE, instAddress, opcode);
 				}
 			}
-			if (dumpAsm) {
-				(*pAsmLines)[instAddress] = asmLine;
-			}
+			if (dumpAsm)
+				pAsm->push_back(record);
 
 			if (pStatement != nullptr) {
-				if (pStatement->type != Statement::LINE_NUM && !pBlock->statements.empty()) {
-					Statement* pLast = pBlock->statements.back();
-					if (pLast->type == Statement::LINE_NUM) {
-						pStatement->setLineNum(pLast->getLineNum());
-						pBlock->pop();
-					}
+				if (pendingLine >= 0) {
+					pStatement->setLineNum(pendingLine);
+					pendingLine = -1;
+				} else if (!pBlock->statements.empty() && pBlock->statements.back()->type == Statement::LINE_NUM) {
+					// One left on its own, uncovered by taking away a clearbuf
+					pStatement->setLineNum(pBlock->statements.back()->getLineNum());
+					pBlock->pop();
 				}
 				pBlock->statements.push_back(pStatement);
 			}
 
 			// Create block if label exists, otherwise just check
-			Block* pNextBlock = cfg.getBlock(buf->getAddress(), info.isLabelled(buf->getAddress()));
+			Block* pNextBlock = cfg.getBlock(nextAddress, info.isLabelled(nextAddress));
 			if (newBlock || pNextBlock) {
+				// Nothing else in this block to take it
+				flushLine(pBlock);
+
 				// if i get the block here, I can dump dead code
 				// it's probably mostly line numbers though
 
-				if (opcode == 0x15 || opcode == 0x16) {
-					if (!stack.empty()) {
-						Logger::Warn(instAddress) << "Stack size is positive.\n" << stack.print();
-					}
+				if (getOpcodeInfo(opcode).flags & OpcodeFlags::ENDS_FUNCTION) {
+					if (!stack.empty())
+						diagnostics.add(Diagnostic::END_NOT_EMPTY, instAddress, stack.height());
 
-					if (dumpAsm) {
-						if (pAsmLines->count(buf->getAddress()) == 0)
-							(*pAsmLines)[buf->getAddress()] = "unmapped";
-					}
+					// Loses to anything else at the address when the lines are merged
+					if (dumpAsm)
+						pAsm->push_back(AsmRecord(nextAddress, AsmRecord::UNMAPPED));
 					break;
 				}
 
 				if (pNextBlock == nullptr)
-					pNextBlock = cfg.getBlock(buf->getAddress(), true);
+					pNextBlock = cfg.getBlock(nextAddress, true);
 
 				// Add successor/predecessor no matter what
 				pBlock->addSuccessor(pNextBlock);
+				if (!pNextBlock->isFunction)
+					checkEntry(pNextBlock, stack);
 
 				if (!newBlock) {
 					pBlock->statements.push_back(new GotoStatement(pNextBlock->index));
@@ -1115,14 +1588,62 @@ void BytecodeParser::parse(ControlFlowGraph& cfg, ScriptInfo& info, std::map<uns
 				pBlock->parsed = true;
 			}
 		}
+		flushLine(pBlock);
 	}
 }
 
-unsigned int BytecodeParser::getInt() {
-	return buf->getInt();
+// A line number nothing took is printed by itself
+void BytecodeParser::flushLine(BasicBlock* pBlock) {
+	if (pendingLine < 0)
+		return;
+	pBlock->statements.push_back(new LineNumStatement(pendingLine));
+	pendingLine = -1;
+}
+
+void BytecodeParser::addLine(unsigned int address, unsigned int line) {
+	// Nearly always in order, blocks are mostly parsed front to back
+	LineEntry entry = {address, line};
+	auto compare = [](const LineEntry& a, const LineEntry& b) { return a.address < b.address; };
+	if (lines.empty() || lines.back().address < address)
+		lines.push_back(entry);
+	else
+		lines.insert(std::upper_bound(lines.begin(), lines.end(), entry, compare), entry);
+}
+
+int BytecodeParser::getLine(unsigned int address) const {
+	auto it = std::upper_bound(lines.begin(), lines.end(), address, [](unsigned int a, const LineEntry& entry) {
+		return a < entry.address;
+	});
+	return (it == lines.begin()) ? -1 : (int) (it - 1)->line;
+}
+
+// Moves onto the instruction at address and returns its opcode
+unsigned char BytecodeParser::fetch(unsigned int address) {
+	if (address >= instructions.getLength())
+		throw std::out_of_range("Buffer out of data");
+
+	pTable = &instructions;
+	unsigned int inst = instructions.find(address);
+	if (inst == InstructionTable::NONE) {
+		oddInstructions.clear();
+		pTable = &oddInstructions;
+		inst = oddInstructions.decode(address);
+	}
+	// Checked here for the whole instruction, so the operands can be read without
+	if (pTable->isTruncated(inst))
+		throw std::out_of_range("Buffer out of data");
+
+	operand = pTable->operandsBegin(inst);
+	nextAddress = pTable->getEnd(inst);
+	return pTable->getOpcode(inst);
 }
-unsigned char BytecodeParser::getChar() {
-	return buf->getChar();
+
+unsigned int BytecodeParser::getTrailingInt() {
+	unsigned int value;
+	if (!pTable->readInt(nextAddress, value))
+		throw std::out_of_range("Buffer out of data");
+	nextAddress += 4;
+	return value;
 }
 /*
 unsigned int BytecodeParser::getArgTypes(std::vector<unsigned int> &argTypes) {
@@ -1138,7 +1659,7 @@ unsigned int BytecodeParser::getArgTypes(std::vector<unsigned int> &argTypes) {
 } */
 
 
-std::string printArgList(const std::vector<unsigned int>& argTypes) {
+std::string printArgList(const TypeList& argTypes) {
 	std::string argList = "(";
 	unsigned int type;
 	for (auto it = argTypes.rbegin(); it != argTypes.rend(); it++) {
@@ -1171,43 +1692,3 @@ std::string printArgList(const std::vector<unsigned int>& argTypes) {
 	return argList;
 }
 
-
-//
-// Buffer of bytecode
-//
-
-BytecodeBuffer::BytecodeBuffer(std::ifstream &f, unsigned int length) {
-	dataLength = length;
-	bytecode = new unsigned char[dataLength];
-
-	f.read((char*) bytecode, dataLength);
-	if (f.fail()) {
-		Logger::Error() << "Tried to read " << dataLength << " bytes, got" << f.gcount() << std::endl;
-		throw std::exception();
-	}
-	Logger::Debug() << "Read " << f.gcount() << " bytes of bytecode." << std::endl;
-}
-
-BytecodeBuffer::~BytecodeBuffer(){
-	delete[] bytecode;
-}
-
-unsigned int BytecodeBuffer::getInt() {
-	unsigned int value = 0;
-	if (currAddress + 4 <= dataLength) {
-		value = readUInt32(bytecode + currAddress);
-		currAddress += 4;
-	} else {
-		throw std::out_of_range("Buffer out of data");
-	}
-	return value;
-}
-unsigned char BytecodeBuffer::getChar() {
-	unsigned char value = 0;
-	if (currAddress < dataLength) {
-		value = bytecode[currAddress++];
-	} else {
-		throw std::out_of_range("Buffer out of data");
-	}
-	return value;
-}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#ifndef DECOMPILER_H
+#define DECOMPILER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+
+#include "Helper.h"
+#include "Structs.h"
+#include "BytecodeParser.h"
+#include "FlightRecorder.h"
+
+// Everything read from SceneInfo.dat
+// Read once and shared (read only) between every scene being decompiled
+struct GlobalInfo {
+	StringList sceneNames;
+	std::vector<VariableInfo> globalVars;
+	std::vector<Function> globalCommands;
+
+	bool read(std::string filename = "SceneInfo.dat");
+};
+
+class ThreadPool;
+
+struct DecompileOptions {
+	int fileIndex = -1;
+	bool dumpAsm = false;
+	// Write every diagnostic of a scene to <scene>.diag
+	bool dumpDiagnostics = false;
+	// If set, the functions of a scene are decompiled in parallel on it
+	ThreadPool* pool = nullptr;
+};
+
+void readScriptHeader(std::ifstream &f, ScriptHeader &header);
+
+class ScriptInfo;
+
+// Temporaries are named var<MARK>n<MARK>, n counting from 0 in each function
+const char TEMPORARY_MARK = '\x01';
+// Numbers them from first, as when a scene's outputs are joined in task order
+std::string numberTemporaries(const std::string& text, unsigned int first);
+
+// Everything one function produces, kept apart so functions can be decompiled in any order
+struct FunctionOutput {
+	std::string source;
+	std::string log;
+	std::string error;
+	DiagnosticLog diagnostics;
+	// Made by this function, numbered from 0 between marks in source and log until numberTemporaries
+	unsigned int numTemporaries = 0;
+	// The instructions leading up to an error, empty if there wasn't one
+	std::vector<FlightRecorder::Record> trace;
+	std::vector<AsmRecord> asmRecords;
+};
+
+// A scene read into memory, with its functions decompiled when first asked for
+// Each function is only decompiled once, however many threads want it
+class Scene {
+	struct Task {
+		std::once_flag once;
+		FunctionOutput output;
+	};
+
+	ScriptHeader header;
+	std::vector<unsigned char> bytecode;
+	// Decoded once for every function
+	std::unique_ptr<InstructionTable> pInstructions;
+	std::unique_ptr<ScriptInfo> pInfo;
+	std::vector<Function> functions;
+	std::vector<std::unique_ptr<Task>> tasks;
+	bool dumpAsm;
+	// File name without its directory, to tag the log with
+	std::string name;
+
+	public:
+		// Throws if the scene cannot be read
+		Scene(const std::string& filename, const GlobalInfo& global, int fileIndex, bool dumpAsm);
+		Scene(const Scene&) = delete;
+		~Scene();
+
+		const ScriptHeader& getHeader() const { return header; }
+		const std::vector<Function>& getFunctions() const { return functions; }
+		unsigned char getAddressWidth() const;
+
+		// Task 0 is the script's own entrypoints, task i is getFunctions()[i - 1]
+		unsigned int numTasks() const { return functions.size() + 1; }
+		// Its temporaries are left for numberTemporaries
+		const FunctionOutput& decompile(unsigned int task);
+		// Decompiles every task, on pool if there is one
+		// Returns how many tasks make up the output, which stops after the first that failed
+		unsigned int decompileAll(ThreadPool* pool);
+		// Assembler of the first count tasks, one line per address in [start, end], in address order
+		void writeAsm(std::ostream& out, unsigned int count, unsigned int start = 0, unsigned int end = 0xFFFFFFFF);
+};
+
+// Bytecode size of a scene, used to schedule the biggest ones first
+unsigned int sceneWeight(const std::string& filename);
+
+// Where the .asm, .diag and .trace dumps of the scene decompiled into outFilename go, next to it
+std::string sideFileName(const std::string& outFilename, const std::string& extension);
+
+// Decompiles one scene into outFilename, with its dumps next to it
+// Returns the error that stopped decompilation, or an empty string on success
+// Throws if the scene cannot be read at all
+std::string decompileScene(const std::string& filename, const std::string& outFilename, const GlobalInfo& global, const DecompileOptions& options);
+
+#endif
@@ -0,0 +1,151 @@
+#include <sstream>
+#include <functional>
+#include <algorithm>
+
+#include "Diagnostics.h"
+#include "Helper.h"
+#include "Logger.h"
+#include "Statements.h"
+
+// In Code order
+// The message takes %t for an arg as a type, %d as a number, %x as hex, %s for the detail
+static const struct {
+	int level;
+	const char* name;
+	const char* message;
+} diagnosticInfo[] = {
+	{Logger::LEVEL_ERROR, "ARG_TYPE", "Expected arg: %t, got %t"},
+	{Logger::LEVEL_ERROR, "POP_TYPE", "Expected type %t, got type %t"},
+	{Logger::LEVEL_ERROR, "CANNOT_POP", "Cannot pop %t"},
+	{Logger::LEVEL_ERROR, "DUP_EMPTY", "Duplicating empty stack."},
+	{Logger::LEVEL_ERROR, "DUP_TYPE", "Dup - Expected type %t, got type %t"},
+	{Logger::LEVEL_ERROR, "ASSIGN_TYPE", "Assign - Expected type %t, got type %t"},
+	{Logger::LEVEL_WARN, "ASSIGN_WITH", "Assigning with %d"},
+	{Logger::LEVEL_ERROR, "CALC1_TYPE", "Calc1 - Expected type %t, got type %t"},
+	{Logger::LEVEL_ERROR, "CALC2_TYPE", "Calc2 - Expected type %t, got type %t"},
+	{Logger::LEVEL_ERROR, "EMPTY_ARGS", "Popping arguments off an empty stack."},
+	{Logger::LEVEL_ERROR, "LOCAL_VAR_RANGE", "Local var index %d out of range."},
+	{Logger::LEVEL_ERROR, "NO_ELEMENT_CODE", "Cannot pop element code - stack empty!"},
+	{Logger::LEVEL_ERROR, "LIST_LENGTH", "Length for %s"},
+	{Logger::LEVEL_WARN, "LOCAL_WITHOUT_REF", "Getting local var without local reference."},
+	{Logger::LEVEL_WARN, "GLOBAL_WITH_REF", "Getting global var with local reference."},
+	{Logger::LEVEL_WARN, "OVERWRITING_VAR", "Overwriting variable."},
+	{Logger::LEVEL_ERROR, "EMPTY_FUNCTION", "Empty function!"},
+	{Logger::LEVEL_ERROR, "RETURN_NOT_EMPTY", "Stack is not empty! (%d left)"},
+	{Logger::LEVEL_WARN, "END_NOT_EMPTY", "Stack size is positive. (%d left)"},
+	{Logger::LEVEL_ERROR, "BAD_TEXT", "%s(%t) cannot be used to add text."},
+	{Logger::LEVEL_ERROR, "BAD_NAME", "%s(%t) cannot be used to set name."},
+	{Logger::LEVEL_WARN, "NO_CLEARBUF", "No preceding 0x54 call. (is this bad?)"},
+	{Logger::LEVEL_ERROR, "UNKNOWN_OPCODE", "NOP: 0x%x"},
+	{Logger::LEVEL_WARN, "BAD_ENTRY", "Stack height going into block %d: %s"},
+};
+static_assert(sizeof(diagnosticInfo) / sizeof(diagnosticInfo[0]) == Diagnostic::NUM_CODES, "Every diagnostic needs a message");
+
+int Diagnostic::getLevel() const {
+	return diagnosticInfo[code].level;
+}
+
+const char* Diagnostic::getName() const {
+	return diagnosticInfo[code].name;
+}
+
+std::string Diagnostic::format() const {
+	std::string text;
+	unsigned int arg = 0;
+	for (const char* p = diagnosticInfo[code].message; *p; p++) {
+		if (*p != '%' || p[1] == 0) {
+			text += *p;
+			continue;
+		}
+		switch (*++p) {
+			case 't': text += VarType(args[arg++]); break;
+			case 'd': text += std::to_string(args[arg++]); break;
+			case 'x': text += toHex(args[arg++]); break;
+			case 's': text += detail; break;
+			default: text += *p; break;
+		}
+	}
+	if (count > 1)
+		text += " (" + std::to_string(count) + " times)";
+	return text;
+}
+
+void DiagnosticLog::add(Diagnostic::Code code, unsigned int address, unsigned int arg0, unsigned int arg1) {
+	add(Diagnostic{code, address, {arg0, arg1}, std::string(), 1});
+}
+
+void DiagnosticLog::add(Diagnostic::Code code, unsigned int address, std::string detail, unsigned int arg0, unsigned int arg1) {
+	add(Diagnostic{code, address, {arg0, arg1}, std::move(detail), 1});
+}
+
+void DiagnosticLog::add(Diagnostic diagnostic) {
+	size_t hash = std::hash<unsigned int>()(diagnostic.address) ^ (diagnostic.code * 0x9E3779B9u);
+	hash = hash * 31 + diagnostic.args[0];
+	hash = hash * 31 + diagnostic.args[1];
+	if (!diagnostic.detail.empty())
+		hash ^= std::hash<std::string>()(diagnostic.detail);
+
+	auto range = index.equal_range(hash);
+	for (auto it = range.first; it != range.second; it++) {
+		Diagnostic& existing = records[it->second];
+		if (existing.code == diagnostic.code && existing.address == diagnostic.address && existing.args[0] == diagnostic.args[0]
+				&& existing.args[1] == diagnostic.args[1] && existing.detail == diagnostic.detail) {
+			existing.count += diagnostic.count;
+			return;
+		}
+	}
+	index.insert(std::make_pair(hash, records.size()));
+	records.push_back(std::move(diagnostic));
+}
+
+void DiagnosticLog::merge(const DiagnosticLog& other) {
+	for (const auto& diagnostic:other.records)
+		add(diagnostic);
+}
+
+bool DiagnosticLog::hasErrors() const {
+	for (const auto& diagnostic:records) {
+		if (diagnostic.getLevel() == Logger::LEVEL_ERROR)
+			return true;
+	}
+	return false;
+}
+
+void DiagnosticLog::print() const {
+	for (const auto& diagnostic:records) {
+		int level = diagnostic.getLevel();
+		if (level > Logger::getLevel())
+			continue;
+		if (level == Logger::LEVEL_ERROR)
+			Logger::Error(diagnostic.address) << diagnostic.format() << std::endl;
+		else
+			Logger::Warn(diagnostic.address) << diagnostic.format() << std::endl;
+	}
+}
+
+std::string DiagnosticLog::summary() const {
+	unsigned int counts[Diagnostic::NUM_CODES] = {};
+	for (const auto& diagnostic:records)
+		counts[diagnostic.code] += diagnostic.count;
+
+	std::string text;
+	for (unsigned int code = 0; code < Diagnostic::NUM_CODES; code++) {
+		if (counts[code] == 0)
+			continue;
+		if (!text.empty())
+			text += ", ";
+		text += std::to_string(counts[code]) + " " + diagnosticInfo[code].name;
+	}
+	return text;
+}
+
+void DiagnosticLog::dump(std::ostream& out) const {
+	for (const auto& diagnostic:records) {
+		std::string detail = diagnostic.detail;
+		std::replace(detail.begin(), detail.end(), '\t', ' ');
+		std::replace(detail.begin(), detail.end(), '\n', ' ');
+		out << "0x" << toHex(diagnostic.address) << "\t" << ((diagnostic.getLevel() == Logger::LEVEL_ERROR) ? "error" : "warning")
+			<< "\t" << diagnostic.getName() << "\t" << diagnostic.count << "\t" << diagnostic.args[0] << "\t" << diagnostic.args[1]
+			<< "\t" << detail << "\n";
+	}
+}
@@ -0,0 +1,76 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <ostream>
+
+// Something wrong with the bytecode, found while parsing it
+// Kept as a code and a few numbers, and only turned into text if it is printed
+struct Diagnostic {
+	enum Code : unsigned char {
+		ARG_TYPE,		// expected, actual
+		POP_TYPE,		// expected, actual
+		CANNOT_POP,		// type
+		DUP_EMPTY,
+		DUP_TYPE,		// expected, actual
+		ASSIGN_TYPE,		// expected, actual
+		ASSIGN_WITH,		// unknown operand
+		CALC1_TYPE,		// expected, actual
+		CALC2_TYPE,		// expected, actual
+		EMPTY_ARGS,
+		LOCAL_VAR_RANGE,	// index
+		NO_ELEMENT_CODE,
+		LIST_LENGTH,		// detail: name, then length
+		LOCAL_WITHOUT_REF,
+		GLOBAL_WITH_REF,
+		OVERWRITING_VAR,
+		EMPTY_FUNCTION,
+		RETURN_NOT_EMPTY,	// height
+		END_NOT_EMPTY,		// height
+		BAD_TEXT,		// type, detail: value
+		BAD_NAME,		// type, detail: value
+		NO_CLEARBUF,
+		UNKNOWN_OPCODE,		// opcode
+		BAD_ENTRY,		// block, detail: heights each way in
+		NUM_CODES
+	};
+
+	Code code;
+	unsigned int address;
+	unsigned int args[2];
+	std::string detail;	// the odd one that needs some text, empty otherwise
+	unsigned int count;	// times it came up
+
+	int getLevel() const;
+	// Short fixed name, for the machine readable dump
+	const char* getName() const;
+	std::string format() const;
+};
+
+// The diagnostics from a function or a scene, each different one once with how many times it came up
+class DiagnosticLog {
+	std::vector<Diagnostic> records;
+	// Records by hash, to find repeats
+	std::unordered_multimap<size_t, unsigned int> index;
+
+	void add(Diagnostic diagnostic);
+	public:
+		void add(Diagnostic::Code code, unsigned int address, unsigned int arg0 = 0, unsigned int arg1 = 0);
+		void add(Diagnostic::Code code, unsigned int address, std::string detail, unsigned int arg0 = 0, unsigned int arg1 = 0);
+		void merge(const DiagnosticLog& other);
+
+		bool empty() const { return records.empty(); }
+		bool hasErrors() const;
+		const std::vector<Diagnostic>& getRecords() const { return records; }
+
+		// Through the logger, so only what the log level lets through is formatted
+		void print() const;
+		// One line of counts by code, like "3 CALC2_TYPE, 1 NO_CLEARBUF"
+		std::string summary() const;
+		// Tab separated: address, level, code, count, both args, detail
+		void dump(std::ostream& out) const;
+};
+
+#endif
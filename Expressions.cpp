@@ -1,6 +1,8 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <typeinfo>
+#include <functional>
 
 #include "Helper.h"
 #include "Logger.h"
@@ -24,6 +26,149 @@ std::string Expression::print(bool) const {
 	return std::string("(value)");
 }
 
+// Structural hashing
+
+static size_t combineHash(size_t seed, size_t h) {
+	return seed ^ (h + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+static size_t hashValue(const Value& value) {
+	return (value == nullptr) ? 0 : value->hash();
+}
+
+static bool equalValues(const Value& a, const Value& b) {
+	if (a == nullptr || b == nullptr)
+		return a == b;
+	return a->equals(*b);
+}
+
+static size_t hashValues(const ValueList& values) {
+	size_t h = values.size();
+	for (const auto& value:values)
+		h = combineHash(h, hashValue(value));
+	return h;
+}
+
+static bool equalValues(const ValueList& a, const ValueList& b) {
+	if (a.size() != b.size())
+		return false;
+	for (unsigned int i = 0; i < a.size(); i++) {
+		if (!equalValues(a[i], b[i]))
+			return false;
+	}
+	return true;
+}
+
+size_t Expression::hash() const {
+	if (cachedHash == 0) {
+		size_t h = combineHash(typeid(*this).hash_code(), hashNode());
+		// 0 means not worked out yet
+		cachedHash = (h == 0) ? 1 : h;
+	}
+	return cachedHash;
+}
+
+// Hashes go first, so unequal trees are usually turned away without walking them
+bool Expression::equals(const Expression& other) const {
+	if (this == &other)
+		return true;
+	if (typeid(*this) != typeid(other) || hash() != other.hash())
+		return false;
+	return equalNode(other);
+}
+
+size_t BinaryExpression::hashNode() const {
+	return combineHash(combineHash(op, hashValue(expr1)), hashValue(expr2));
+}
+
+bool BinaryExpression::equalNode(const Expression& other) const {
+	const BinaryExpression& rhs = static_cast<const BinaryExpression&>(other);
+	return op == rhs.op && equalValues(expr1, rhs.expr1) && equalValues(expr2, rhs.expr2);
+}
+
+size_t UnaryExpression::hashNode() const {
+	return combineHash(op, hashValue(expr));
+}
+
+bool UnaryExpression::equalNode(const Expression& other) const {
+	const UnaryExpression& rhs = static_cast<const UnaryExpression&>(other);
+	return op == rhs.op && equalValues(expr, rhs.expr);
+}
+
+// Strings are compared by contents, anything else by value, and both by type
+size_t RawValueExpr::hashNode() const {
+	if (type == ValueType::STR)
+		return combineHash(type, std::hash<std::string>()(str));
+	return combineHash(type, value);
+}
+
+bool RawValueExpr::equalNode(const Expression& other) const {
+	const RawValueExpr& rhs = static_cast<const RawValueExpr&>(other);
+	if (type != rhs.type)
+		return false;
+	return (type == ValueType::STR) ? (str == rhs.str) : (value == rhs.value);
+}
+
+size_t VariableExpression::hashNode() const {
+	return std::hash<Symbol>()(name);
+}
+
+bool VariableExpression::equalNode(const Expression& other) const {
+	return name == static_cast<const VariableExpression&>(other).name;
+}
+
+size_t ListExpression::hashNode() const {
+	return hashValues(elements);
+}
+
+bool ListExpression::equalNode(const Expression& other) const {
+	return equalValues(elements, static_cast<const ListExpression&>(other).elements);
+}
+
+size_t NotExpr::hashNode() const {
+	return hashValue(cond);
+}
+
+bool NotExpr::equalNode(const Expression& other) const {
+	return equalValues(cond, static_cast<const NotExpr&>(other).cond);
+}
+
+size_t FunctionExpr::hashNode() const {
+	size_t h = (callValue != nullptr) ? callValue->hash() : std::hash<Symbol>()(name);
+	return hasExtra ? combineHash(h, extraCall) : h;
+}
+
+bool FunctionExpr::equalNode(const Expression& other) const {
+	const FunctionExpr& rhs = static_cast<const FunctionExpr&>(other);
+	if (hasExtra != rhs.hasExtra || (hasExtra && extraCall != rhs.extraCall))
+		return false;
+	if (callValue != nullptr || rhs.callValue != nullptr)
+		return equalValues(callValue, rhs.callValue);
+	return name == rhs.name;
+}
+
+size_t CallExpr::hashNode() const {
+	size_t h = combineHash(callFunc->hash(), fnOption);
+	h = combineHash(h, hashValues(fnArgs));
+	for (const auto& extra:fnExtra)
+		h = combineHash(h, extra);
+	return h;
+}
+
+bool CallExpr::equalNode(const Expression& other) const {
+	const CallExpr& rhs = static_cast<const CallExpr&>(other);
+	return fnOption == rhs.fnOption && fnExtra == rhs.fnExtra && callFunc->equals(*rhs.callFunc) && equalValues(fnArgs, rhs.fnArgs);
+}
+
+size_t ShortCallExpr::hashNode() const {
+	return combineHash(blockIndex, hashValues(fnArgs));
+}
+
+bool ShortCallExpr::equalNode(const Expression& other) const {
+	const ShortCallExpr& rhs = static_cast<const ShortCallExpr&>(other);
+	return blockIndex == rhs.blockIndex && equalValues(fnArgs, rhs.fnArgs);
+}
+
 
 //	Precedence table
 //  [-] [~] [!]
@@ -131,6 +276,7 @@ std::string BinaryExpression::print(bool hex) const {
 }
 
 void BinaryExpression::negateBool() {
+	rehash();
 	switch (op) {
 		case 0x10: op = 0x11; break;
 		case 0x11: op = 0x10; break;
@@ -234,7 +380,7 @@ IndexValueExpr::IndexValueExpr(Value e1, Value e2) : BinaryExpression(std::move(
 		throw std::logic_error("Bad index");
 	}
 
-	Logger::VVDebug() << expr1->print() << " is array of type " << VarType(expr1->getType()) << "\n";
+	LOG_VVDEBUG() << expr1->print() << " is array of type " << VarType(expr1->getType()) << "\n";
 
 	// Set type of value
 	unsigned int arrType = expr1->getType();
@@ -311,31 +457,33 @@ std::string NotExpr::print(bool hex) const {
 }
 
 
-// fix
-unsigned int VariableExpression::varCount = 0;
-VariableExpression::VariableExpression(std::string name_, unsigned int type_, unsigned int length_) : Expression(type_), name(name_) {
-	listLength = length_;
+static void checkLength(unsigned int type, unsigned int length) {
 	if (type == ValueType::INT || type == ValueType::STR) {
-		if (listLength > 0)
+		if (length > 0)
 			Logger::Error() << VarType(type) << " cannot have positive length.\n";
 	}
+}
 
-	Logger::VDebug() << "Created var " << name << " (" << VarType(type) << ")\n";
+VariableInfo::VariableInfo(Symbol name_, unsigned int type_, unsigned int length_) : name(name_), type(type_), length(length_) {
+	checkLength(type, length);
 }
 
-VariableExpression::VariableExpression(unsigned int type) : Expression(type) {
-	name = "var" + std::to_string(varCount++);
+VariableExpression::VariableExpression(Symbol name_, unsigned int type_, unsigned int length_) : Expression(type_), name(name_) {
+	listLength = length_;
+	checkLength(type, listLength);
+
+	LOG_VDEBUG() << "Created var " << name << " (" << VarType(type) << ")\n";
 }
 
 
 std::string VariableExpression::print(bool hex) const {
 	if (!name.empty())
-		return name;
+		return name.str();
 	else
 		return Expression::print(hex);
 }
 
-ListExpression::ListExpression(std::vector<Value> elements_) : elements(std::move(elements_)) {
+ListExpression::ListExpression(ValueList elements_) : elements(std::move(elements_)) {
 	listLength = elements.size();
 	type = ValueType::INT_LIST;	// check
 }
@@ -366,11 +514,11 @@ std::string ErrValueExpr::print(bool) const {
 
 }
 
-CallExpr::CallExpr(FunctionExpr* fnCall_, unsigned int option_, std::vector<Value> args_, std::vector<unsigned int> extraList_, unsigned int returnType_) : callFunc(fnCall_) {
+CallExpr::CallExpr(FunctionExpr* fnCall_, unsigned int option_, ValueList args_, TypeList extraList_, unsigned int returnType_) : callFunc(fnCall_) {
 	type = returnType_;
 	fnOption = option_;
 	fnArgs = std::move(args_);
-	fnExtra = extraList_;
+	fnExtra = std::move(extraList_);
 }
 
 CallExpr::CallExpr(const CallExpr& copy) : Expression(copy), callFunc(copy.callFunc->clone()), fnOption(copy.fnOption), fnExtra(copy.fnExtra) {
@@ -415,14 +563,14 @@ std::string FunctionExpr::print(bool hex) const {
 	if (callValue != nullptr)
 		ret = callValue->print(hex);
 	else
-		ret = name;
+		ret = name.str();
 
 	if (hasExtra)
 		ret += "<" + std::to_string(extraCall) + ">";
 	return ret;
 }
 
-FunctionExpr::FunctionExpr(const FunctionExpr& copy) : name(copy.name) {
+FunctionExpr::FunctionExpr(const FunctionExpr& copy) : Expression(copy), name(copy.name), hasExtra(copy.hasExtra), extraCall(copy.extraCall) {
 	if (copy.callValue != nullptr)
 		callValue = Value(copy.callValue->clone());
 	else
@@ -430,7 +578,7 @@ FunctionExpr::FunctionExpr(const FunctionExpr& copy) : name(copy.name) {
 }
 
 
-ShortCallExpr::ShortCallExpr(unsigned int index, std::vector<Value> args) {
+ShortCallExpr::ShortCallExpr(unsigned int index, ValueList args) {
 	blockIndex = index;
 	fnArgs = std::move(args);
 
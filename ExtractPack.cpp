@@ -15,7 +15,6 @@ void readFileInfo(std::ifstream &stream, FileInfo &pair) {
 	stream.read((char*) &pair.length, sizeof(uint64_t));
 }
 
-int Logger::LogLevel = Logger::LEVEL_INFO;
 int main(int argc, char* argv[]) {
 	static char usageString[] = "Usage: extractpck <input.pck> [outfile]";
 	if (argc < 2) {
@@ -0,0 +1,20 @@
+#include "FlightRecorder.h"
+#include "Instructions.h"
+#include "Helper.h"
+
+std::vector<FlightRecorder::Record> FlightRecorder::snapshot() const {
+	std::vector<Record> trace;
+	unsigned int start = (next > SIZE) ? next - SIZE : 0;
+	trace.reserve(next - start);
+	for (unsigned int i = start; i != next; i++)
+		trace.push_back(records[i & (SIZE - 1)]);
+	return trace;
+}
+
+void writeTrace(std::ostream& out, const std::vector<FlightRecorder::Record>& trace) {
+	for (const auto& record:trace) {
+		const char* mnemonic = getOpcodeInfo(record.opcode).mnemonic;
+		out << "0x" << toHex(record.address) << "\t" << (mnemonic ? mnemonic : "?") << " (0x" << toHex(record.opcode, 2) << ")"
+			<< "\t" << std::to_string(record.height) << "\tL" << std::to_string(record.block) << "\n";
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef FLIGHTRECORDER_H
+#define FLIGHTRECORDER_H
+
+#include <vector>
+#include <ostream>
+
+// The last instructions a thread parsed, kept whatever the log level
+// so that when a function fails there is something to say how it got there
+// Only its own thread touches it, so recording is a few stores and no locking
+class FlightRecorder {
+	public:
+		struct Record {
+			unsigned int address;
+			unsigned int block;
+			unsigned int height;	// of the operand stack, before the instruction
+			unsigned char opcode;
+		};
+		// Has to be a power of two
+		static const unsigned int SIZE = 1024;
+	private:
+		Record records[SIZE];
+		unsigned int next = 0;
+	public:
+		static FlightRecorder& local() {
+			static thread_local FlightRecorder recorder;
+			return recorder;
+		}
+
+		void record(unsigned int address, unsigned char opcode, unsigned int height, unsigned int block) {
+			Record& r = records[next++ & (SIZE - 1)];
+			r.address = address;
+			r.block = block;
+			r.height = height;
+			r.opcode = opcode;
+		}
+		void clear() { next = 0; }
+
+		// Oldest first
+		std::vector<Record> snapshot() const;
+};
+
+// One line per record: address, mnemonic, stack height, block
+void writeTrace(std::ostream& out, const std::vector<FlightRecorder::Record>& trace);
+
+#endif
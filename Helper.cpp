@@ -6,9 +6,10 @@
 #include "Structs.h"
 #include "Logger.h"
 
-std::wstring_convert<std::codecvt_utf8<char16_t>, char16_t> g_UCS2Conv;
+// Converters keep state, so each thread gets its own
+thread_local std::wstring_convert<std::codecvt_utf8<char16_t>, char16_t> g_UCS2Conv;
 
-unsigned int readUInt32(unsigned char* buf) {
+unsigned int readUInt32(const unsigned char* buf) {
 	return buf[0] + (buf[1] << 8) + (buf[2] << 16) + (buf[3] << 24);
 }
 
@@ -69,7 +70,7 @@ void readStrings(std::ifstream &f, StringList &strings, HeaderPair index, Header
 
 	delete[] stringIndices;
 	
-	Logger::Debug() << "Read " << strings.size() << " strings from 0x" << std::hex << data.offset << std::dec << std::endl;
+	LOG_DEBUG() << "Read " << strings.size() << " strings from 0x" << std::hex << data.offset << std::dec << std::endl;
 }
 
 // Requires stream pointer to be at beginning of table
@@ -6,6 +6,7 @@
 #include <vector>
 #include <iomanip>
 #include <sstream>
+#include <memory>
 
 #include "Structs.h"
 
@@ -27,7 +28,7 @@ static inline std::string toHex(unsigned int c, unsigned char width = 0) {
 
 typedef std::vector<std::string> StringList;
  
-unsigned int readUInt32(unsigned char* buf);
+unsigned int readUInt32(const unsigned char* buf);
 unsigned int readUInt32(char* buf);
 void readHeaderPair(std::ifstream &stream, HeaderPair &pair);
 void readHeaderPair(unsigned char* buf, HeaderPair &pair);
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include "Instructions.h"
+#include "Helper.h"
+#include "Bitset.h"
+
+const unsigned int InstructionTable::NONE;
+
+using namespace OpcodeFlags;
+
+// Sorted by opcode
+static constexpr OpcodeInfo opcodeList[] = {
+	{0x01, "line",        "i",    0},
+	{0x02, "push",        "tx",   0},
+	{0x03, "pop",         "t",    0},
+	{0x04, "dup",         "t",    0},
+	{0x05, "eval",        "",     0},
+	{0x06, "dup element", "",     0},
+	{0x07, "var",         "tv",   0},
+	{0x08, "frame",       "",     0},
+	{0x09, "endparams",   "",     0},
+	{0x10, "jmp",         "l",    JUMP},
+	{0x11, "jnz",         "l",    BRANCH},
+	{0x12, "jz",          "l",    BRANCH},
+	{0x13, "gosub",       "la",   CALL},
+	{0x14, "gosub",       "la",   CALL},
+	{0x15, "ret",         "a",    ENDS_FUNCTION},
+	{0x16, "endscript",   "",     ENDS_FUNCTION},
+	{0x20, "assign",      "ttx",  0},
+	{0x21, "calc1",       "tc",   0},
+	{0x22, "calc2",       "ttc",  0},
+	{0x30, "call",        "iant", MAYBE_TRAILER},	// option, args, extra list, return type
+	{0x31, "addtext",     "i",    0},	// text id
+	{0x32, "setname",     "",     0},
+};
+static constexpr unsigned int numOpcodes = sizeof(opcodeList) / sizeof(opcodeList[0]);
+static constexpr OpcodeInfo unknownOpcode = {0x00, nullptr, "", 0};
+
+static constexpr bool isSorted(unsigned int i = 1) {
+	return (i >= numOpcodes) || (opcodeList[i - 1].opcode < opcodeList[i].opcode && isSorted(i + 1));
+}
+static_assert(isSorted(), "Opcode table has to be sorted, without repeats");
+
+const OpcodeInfo& getOpcodeInfo(unsigned char opcode) {
+	// Spread out by opcode the first time round
+	static const std::vector<const OpcodeInfo*> byOpcode = []() {
+		std::vector<const OpcodeInfo*> table(0x100, &unknownOpcode);
+		for (const auto& info:opcodeList)
+			table[info.opcode] = &info;
+		return table;
+	}();
+	return *byOpcode[opcode];
+}
+
+InstructionTable::InstructionTable(const unsigned char* bytecode_, unsigned int length_, bool sweep) : bytecode(bytecode_), length(length_) {
+	if (!sweep)
+		return;
+
+	// Only needed while sweeping, find goes through byAddress after
+	Bitset seen(length);
+	std::vector<unsigned int> starts({0});
+	while (!starts.empty()) {
+		unsigned int address = starts.back();
+		starts.pop_back();
+
+		// Until it runs into something already decoded
+		while (address < length && !seen.get(address)) {
+			unsigned int inst = decode(address);
+			// Left for the parser to decode properly if it ever gets there
+			if (truncated[inst]) {
+				drop();
+				break;
+			}
+			seen.set(address);
+			address = ends[inst];
+			if (getOpcodeInfo(opcodes[inst]).flags & MAYBE_TRAILER)
+				starts.push_back(address + 4);
+		}
+	}
+
+	byAddress.resize(addresses.size());
+	for (unsigned int inst = 0; inst < byAddress.size(); inst++)
+		byAddress[inst] = inst;
+	std::sort(byAddress.begin(), byAddress.end(), [this](unsigned int a, unsigned int b) {
+		return addresses[a] < addresses[b];
+	});
+}
+
+unsigned int InstructionTable::find(unsigned int address) const {
+	auto it = std::lower_bound(byAddress.begin(), byAddress.end(), address, [this](unsigned int inst, unsigned int value) {
+		return addresses[inst] < value;
+	});
+	if (it == byAddress.end() || addresses[*it] != address)
+		return NONE;
+	return *it;
+}
+
+// Takes the last instruction back out
+void InstructionTable::drop() {
+	operands.resize(operandStart.back());
+	addresses.pop_back();
+	opcodes.pop_back();
+	ends.pop_back();
+	operandStart.pop_back();
+	truncated.pop_back();
+}
+
+void InstructionTable::clear() {
+	addresses.clear();
+	opcodes.clear();
+	ends.clear();
+	operandStart.clear();
+	truncated.clear();
+	operands.clear();
+}
+
+bool InstructionTable::readInt(unsigned int address, unsigned int& value) const {
+	if (address > length || length - address < 4)
+		return false;
+	value = readUInt32(bytecode + address);
+	return true;
+}
+
+unsigned int InstructionTable::readOperand(unsigned int& address) {
+	const unsigned char* p = bytecode + address;
+	unsigned int value = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+	operands.push_back(value);
+	address += 4;
+	return value;
+}
+
+// Count, then a type for each, with 0xFFFFFFFF starting a nested list
+bool InstructionTable::readArgs(unsigned int& address, unsigned int& spare) {
+	unsigned int numArgs = readOperand(address);
+	if (numArgs > spare / 4)
+		return false;
+	spare -= numArgs * 4;
+	for (unsigned int i = 0; i < numArgs; i++) {
+		if (readOperand(address) == 0xFFFFFFFF) {
+			// Room for the nested count too
+			if (spare < 4)
+				return false;
+			spare -= 4;
+			if (!readArgs(address, spare))
+				return false;
+		}
+	}
+	return true;
+}
+
+unsigned int InstructionTable::decode(unsigned int address) {
+	unsigned int inst = addresses.size();
+	unsigned char opcode = bytecode[address];
+	addresses.push_back(address);
+	opcodes.push_back(opcode);
+	operandStart.push_back(operands.size());
+
+	// Checked once for the fixed part, then once per list
+	const OpcodeInfo& info = getOpcodeInfo(opcode);
+	unsigned int pos = address + 1;
+	unsigned int spare = length - pos;
+	bool ok = (spare >= info.fixedSize);
+	if (ok)
+		spare -= info.fixedSize;
+	for (const char* pOperand = info.operands; ok && *pOperand; pOperand++) {
+		switch (*pOperand) {
+			case 'i': case 'x': case 't': case 'l': case 'v':
+				readOperand(pos);
+			break;
+			case 'c':
+				operands.push_back(bytecode[pos++]);
+			break;
+			case 'a':
+				ok = readArgs(pos, spare);
+			break;
+			case 'n': {
+				unsigned int count = readOperand(pos);
+				ok = (count <= spare / 4);
+				if (ok) {
+					spare -= count * 4;
+					for (unsigned int i = 0; i < count; i++)
+						readOperand(pos);
+				}
+			} break;
+		}
+	}
+
+	ends.push_back(pos);
+	truncated.push_back(!ok);
+	return inst;
+}
@@ -0,0 +1,92 @@
+#ifndef INSTRUCTIONS_H
+#define INSTRUCTIONS_H
+
+#include <vector>
+
+namespace OpcodeFlags {
+	const unsigned char ENDS_FUNCTION = 0x01;
+	const unsigned char JUMP          = 0x02;
+	const unsigned char BRANCH        = 0x04;	// conditional jump
+	const unsigned char CALL          = 0x08;
+	const unsigned char MAYBE_TRAILER = 0x10;	// sometimes followed by one more int, which the sweep also tries
+}
+
+// Everything the decoder, parser and assembler printer need to know about an opcode, in one place
+// (see the table in Instructions.cpp, which is where a new opcode goes)
+struct OpcodeInfo {
+	constexpr OpcodeInfo(unsigned char opcode_, const char* mnemonic_, const char* operands_, unsigned char flags_) :
+		opcode(opcode_), mnemonic(mnemonic_), operands(operands_), flags(flags_), fixedSize(sizeOf(operands_)) {}
+
+	unsigned char opcode;
+	const char* mnemonic;	// null if unknown
+	// One letter per operand, in order, which says both how to read it and how to print it:
+	//   i int (decimal), x int (hex), t value type, l label index, v local variable index, c char (hex),
+	//   a argument list (count, then types, 0xFFFFFFFF nesting another list), n count then that many ints
+	const char* operands;
+	unsigned char flags;
+	// Bytes taken by the operands, apart from what is in the lists
+	unsigned char fixedSize;
+
+	static constexpr unsigned char sizeOf(const char* operands) {
+		return (*operands == 0) ? 0 : ((*operands == 'c') ? 1 : 4) + sizeOf(operands + 1);
+	}
+};
+
+// Unknown opcodes have no operands and no mnemonic
+const OpcodeInfo& getOpcodeInfo(unsigned char opcode);
+
+// The instructions of a scene's bytecode, decoded once and shared (read only) by every function's parser
+// Kept as parallel arrays with one entry per decoded instruction, and found by address
+//
+// A call (0x30) can be followed by one more int, depending on what is on the stack, which only the parser knows
+// So decoding goes on from both places after a call, and an instruction starting anywhere the parser can land is in the table
+// (decoding only depends on the bytes from the start of the instruction, so the wrong guess is just never looked at)
+class InstructionTable {
+	const unsigned char* bytecode;
+	unsigned int length;
+
+	std::vector<unsigned int> addresses;
+	std::vector<unsigned char> opcodes;
+	std::vector<unsigned int> ends;		// address just past the operands
+	std::vector<unsigned int> operandStart;	// first operand, the next instruction's are where these stop
+	std::vector<bool> truncated;		// bytecode ran out partway through
+	// Every int operand, in the order the parser reads them (chars are widened)
+	std::vector<unsigned int> operands;
+	// Swept instructions sorted by address, for find
+	std::vector<unsigned int> byAddress;
+
+	// Nothing is checked here, decode makes sure the bytes are there first
+	unsigned int readOperand(unsigned int& address);
+	// Spare is what's left past the rest of the instruction's fixed operands, and each list takes its room from it
+	bool readArgs(unsigned int& address, unsigned int& spare);
+	void drop();
+	public:
+		static const unsigned int NONE = 0xFFFFFFFF;
+
+		// Without sweep the table starts empty, for decoding odd instructions one at a time
+		InstructionTable(const unsigned char* bytecode, unsigned int length, bool sweep = true);
+
+		const unsigned char* getBytecode() const { return bytecode; }
+		unsigned int getLength() const { return length; }
+		unsigned int size() const { return addresses.size(); }
+
+		// NONE if no decoded instruction starts there
+		unsigned int find(unsigned int address) const;
+		// Decodes the instruction at address (which has to be inside the bytecode) and returns where it went
+		// Anything that would run past the end is marked truncated, without reading further
+		unsigned int decode(unsigned int address);
+		void clear();
+
+		unsigned int getAddress(unsigned int inst) const { return addresses[inst]; }
+		unsigned char getOpcode(unsigned int inst) const { return opcodes[inst]; }
+		unsigned int getEnd(unsigned int inst) const { return ends[inst]; }
+		bool isTruncated(unsigned int inst) const { return truncated[inst]; }
+		unsigned int operandsBegin(unsigned int inst) const { return operandStart[inst]; }
+		unsigned int operandsEnd(unsigned int inst) const { return (inst + 1 < operandStart.size()) ? operandStart[inst + 1] : operands.size(); }
+		unsigned int getOperand(unsigned int n) const { return operands[n]; }
+
+		// Straight from the bytecode, for the int after a call
+		bool readInt(unsigned int address, unsigned int& value) const;
+};
+
+#endif
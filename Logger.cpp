@@ -0,0 +1,46 @@
+#include <mutex>
+
+#include "Logger.h"
+
+namespace Logger {
+	std::atomic<int> LogLevel(LEVEL_INFO);
+
+	// Guards the sink, and keeps lines from different threads apart
+	static std::mutex sinkMutex;
+	static std::ostream* pSink = &std::cout;
+	static std::ofstream sinkFile;
+
+	bool setSink(const std::string& name) {
+		std::lock_guard<std::mutex> lock(sinkMutex);
+		if (sinkFile.is_open())
+			sinkFile.close();
+
+		if (name == "stdout") {
+			pSink = &std::cout;
+		} else if (name == "stderr") {
+			pSink = &std::cerr;
+		} else if (name == "none") {
+			pSink = nullptr;
+		} else {
+			sinkFile.open(name, std::ofstream::out | std::ofstream::app);
+			if (!sinkFile.is_open()) {
+				pSink = &std::cerr;
+				return false;
+			}
+			pSink = &sinkFile;
+		}
+		return true;
+	}
+
+	void writeLines(const char* data, size_t length) {
+		std::lock_guard<std::mutex> lock(sinkMutex);
+		if (pSink != nullptr)
+			pSink->write(data, length);
+	}
+
+	void flush() {
+		std::lock_guard<std::mutex> lock(sinkMutex);
+		if (pSink != nullptr)
+			pSink->flush();
+	}
+}
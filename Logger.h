@@ -3,6 +3,9 @@
 
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <cstring>
+#include <atomic>
 
 #define ANSI_RESET "\x1b[0m"
 #define ANSI_RED "\x1b[31m"
@@ -15,8 +18,125 @@ namespace Logger {
   		return c;
   	}
 	};
-	static NullBuffer nullBuf;
-	static std::ostream nout(&nullBuf);
+
+	// Per thread, so scenes decompiled in parallel don't share stream state
+	inline std::ostream& NullStream() {
+		static thread_local NullBuffer nullBuf;
+		static thread_local std::ostream nout(&nullBuf);
+		return nout;
+	}
+
+	// Where the log ends up: "stdout" (the default), "stderr", "none" or a file name
+	// Returns false if the file can't be opened
+	bool setSink(const std::string& name);
+	// Writes whole lines to the sink, in one go so other threads' lines can't get in between
+	void writeLines(const char* data, size_t length);
+	// Before a fork, so nothing buffered gets written twice
+	void flush();
+
+	// What this thread is working on, put in front of each of its lines, e.g. "sc01.ss:main"
+	inline std::string& Tag() {
+		static thread_local std::string tag;
+		return tag;
+	}
+
+	// Holds on to what a thread logs until the end of a line, then hands it on with the thread's tag in front of each line
+	// Goes to the sink, or to the stream a log is being kept in
+	class LineBuffer : public std::streambuf {
+		std::string pending;
+		std::ostream* pTarget = nullptr;
+
+		void write(const char* data, size_t length) {
+			if (pTarget != nullptr)
+				pTarget->write(data, length);
+			else
+				writeLines(data, length);
+		}
+		void writeComplete() {
+			size_t end = pending.rfind('\n');
+			if (end == std::string::npos)
+				return;
+			const std::string& tag = Tag();
+			if (tag.empty()) {
+				write(pending.data(), end + 1);
+			} else {
+				std::string lines;
+				for (size_t start = 0; start <= end;) {
+					size_t next = pending.find('\n', start) + 1;
+					lines += "[" + tag + "] ";
+					lines.append(pending, start, next - start);
+					start = next;
+				}
+				write(lines.data(), lines.size());
+			}
+			pending.erase(0, end + 1);
+		}
+		protected:
+			int overflow(int c) override {
+				if (c != EOF) {
+					pending += (char) c;
+					if (c == '\n')
+						writeComplete();
+				}
+				return c;
+			}
+			std::streamsize xsputn(const char* s, std::streamsize n) override {
+				pending.append(s, n);
+				if (std::memchr(s, '\n', n) != nullptr)
+					writeComplete();
+				return n;
+			}
+		public:
+			// The tag is made first so it is still there when a thread's buffer goes
+			LineBuffer() { Tag(); }
+			LineBuffer(std::ostream& target) : pTarget(&target) {}
+			LineBuffer(const LineBuffer&) = delete;
+			~LineBuffer() {
+				if (!pending.empty()) {
+					pending += '\n';
+					writeComplete();
+				}
+			}
+
+			// Lines that were tagged when they were first logged, passed on as they are
+			void forward(const std::string& lines) {
+				write(lines.data(), lines.size());
+			}
+	};
+
+	inline std::ostream& LineStream() {
+		static thread_local LineBuffer lineBuf;
+		static thread_local std::ostream lout(&lineBuf);
+		return lout;
+	}
+
+	// Where this thread's log goes
+	inline std::ostream*& OutStream() {
+		static thread_local std::ostream* pStream = &LineStream();
+		return pStream;
+	}
+
+	// Sends this thread's log to another stream until it goes out of scope
+	// Lines are tagged on the way in, so the kept log can be forwarded on later without losing where each came from
+	class Redirect {
+		std::ostream* pPrevious;
+		LineBuffer buffer;
+		std::ostream out;
+		public:
+			Redirect(std::ostream& stream) : pPrevious(OutStream()), buffer(stream), out(&buffer) { OutStream() = &out; }
+			Redirect(const Redirect&) = delete;
+			~Redirect() { OutStream() = pPrevious; }
+	};
+
+	// Writes out a log kept with Redirect, without tagging its lines again
+	inline void Forward(const std::string& lines) {
+		std::ostream& stream = *OutStream();
+		LineBuffer* pBuffer = dynamic_cast<LineBuffer*>(stream.rdbuf());
+		if (pBuffer != nullptr)
+			pBuffer->forward(lines);
+		else
+			stream << lines;
+	}
 
 	const int LEVEL_NONE = 0;
 	const int LEVEL_ERROR = 1;
@@ -26,16 +146,29 @@ namespace Logger {
 	const int LEVEL_VERBOSE_DEBUG = 5;
 	const int LEVEL_VERBOSE_VERBOSE_DEBUG = 6;
 
-	extern int LogLevel;
+	// Any thread can read it while another changes it
+	extern std::atomic<int> LogLevel;
+	inline int getLevel() {
+		return LogLevel.load(std::memory_order_relaxed);
+	}
+
+	// Sets this thread's tag until it goes out of scope
+	class Context {
+		std::string previous;
+		public:
+			Context(const std::string& tag) : previous(Tag()) { Tag() = tag; }
+			Context(const Context&) = delete;
+			~Context() { Tag() = previous; }
+	};
 	
-	inline std::ostream& Log(int level, unsigned int address, std::ostream& stream = std::cout) {
-		if (level <= LogLevel) {
+	inline std::ostream& Log(int level, unsigned int address, std::ostream& stream = *OutStream()) {
+		if (level <= getLevel()) {
 			if (address != 0xFFFFFFFF)
-				return stream << "0x" << std::hex << address << ": ";
+				return stream << "0x" << std::hex << address << std::dec << ": ";
 			else
 				return stream;
 		} else {
-			return nout;
+			return NullStream();
 		}
 	}
 
@@ -73,4 +206,20 @@ namespace Logger {
 	}
 }
 
+// Highest level that gets compiled in at all, e.g. -DLOG_MAX_LEVEL=3 to drop every debug line
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL Logger::LEVEL_VERBOSE_VERBOSE_DEBUG
+#endif
+
+// Whether a line at level would be written
+// The first half is constant, so the compiler throws out lines above LOG_MAX_LEVEL
+#define LOG_ENABLED(level) ((level) <= LOG_MAX_LEVEL && (level) <= Logger::getLevel())
+
+// Used like the functions, LOG_VVDEBUG(address) << ...
+// but nothing after the << is evaluated unless the line is going to be written
+#define LOG_AT(level, function) if (!LOG_ENABLED(level)) {} else Logger::function
+#define LOG_DEBUG(...) LOG_AT(Logger::LEVEL_DEBUG, Debug)(__VA_ARGS__)
+#define LOG_VDEBUG(...) LOG_AT(Logger::LEVEL_VERBOSE_DEBUG, VDebug)(__VA_ARGS__)
+#define LOG_VVDEBUG(...) LOG_AT(Logger::LEVEL_VERBOSE_VERBOSE_DEBUG, VVDebug)(__VA_ARGS__)
+
 #endif
\ No newline at end of file
@@ -33,7 +33,6 @@ static unsigned char XorKey[256] = {
 	0x9D, 0xEA, 0xDD, 0x31, 0x2C, 0xE9, 0xE2, 0x10, 0x22, 0xAA, 0xE1, 0xAD, 0x2C, 0xC4, 0x2D, 0x7F
 };
 
-int Logger::LogLevel = Logger::LEVEL_INFO;
 int main(int argc, char* argv[]) {
 	extern char *optarg;
 	extern int optind;
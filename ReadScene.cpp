@@ -16,6 +16,9 @@
 #include <fstream>
 #include <iomanip>
 #include <cstdint>
+#include <limits>
+#include <chrono>
+#include <algorithm>
 
 #include <cassert>
 #include <unistd.h>
@@ -24,6 +27,7 @@
 #include "Helper.h"
 #include "Structs.h"
 #include "Logger.h"
+#include "Shard.h"
 
 void readScenePackHeader(std::ifstream &f, ScenePackHeader &header) {
 	f.read((char*) &header.headerSize, 4);
@@ -49,25 +53,64 @@ void readScenePackHeader(std::ifstream &f, ScenePackHeader &header) {
 	f.read((char*) &header.sourceHeaderLength, 4);	// Figure this out. It's at the end of the data, taunting me
 }
 
-int Logger::LogLevel = Logger::LEVEL_INFO;
+// readscene merge: combine the outputs of a sharded extraction
+static int mergeMain(int argc, char* argv[]) {
+	static char usageString[] = "Usage: readscene merge -o outdir <shard dir>...";
+
+	std::string outDir;
+	int option = 0;
+	while ((option = getopt(argc, argv, "o:v")) != -1) {
+		switch (option) {
+		case 'v':
+			Logger::increaseVerbosity();
+			break;
+		case 'o':
+			outDir = std::string(optarg);
+		break;
+		default:
+			std::cout << usageString << std::endl;
+			return 1;
+		}
+	}
+	if (outDir.empty() || optind >= argc) {
+		std::cout << usageString << std::endl;
+		return 1;
+	}
+
+	ShardManifest merged;
+	if (!mergeShards(std::vector<std::string>(argv + optind, argv + argc), outDir, merged))
+		return 1;
+	Logger::Info() << "Merged " << std::to_string(merged.entries.size()) << " scenes from " << std::to_string(merged.shard.count) << " shards.\n";
+	return 0;
+}
+
 int main(int argc, char* argv[]) {
 	extern char *optarg;
 	extern int optind;
+
+	if (argc > 1 && std::string(argv[1]) == "merge")
+		return mergeMain(argc - 1, argv + 1);
 	
-	static char usageString[] = "Usage: readscene [-d outdir] [-v] [-k xorkey] [Scene.pck]";
+	static char usageString[] = "Usage: readscene [-d outdir] [-v] [-k xorkey] [--shard i/N] [Scene.pck]\n"
+		"       readscene merge -o outdir <shard dir>...";
 	
+	std::string outdir("Scene");
 	bool keyProvided = false;
 	unsigned char extraKey[16];
+	Shard shard;
+	static struct option longOptions[] = {
+		{"shard", required_argument, nullptr, 's'},
+		{nullptr, 0, nullptr, 0}
+	};
 	
 	int option = 0;
-	while ((option = getopt(argc, argv, "d:vk:")) != -1) {
+	while ((option = getopt_long(argc, argv, "d:vk:", longOptions, nullptr)) != -1) {
 		switch (option) {
 		case 'v':
 			Logger::increaseVerbosity();
 			break;
 		case 'd':
-			std::cout << "Wait, don't actually use this yet: " << optarg << std::endl;
-			return 0;
+			outdir = std::string(optarg);
 		break;
 		case 'k': {
 			keyProvided = true;
@@ -75,6 +118,12 @@ int main(int argc, char* argv[]) {
 			keyfile.read((char*) extraKey, 16);
 			keyfile.close();
 		} break;
+		case 's':
+			if (!shard.parse(optarg)) {
+				Logger::Error() << "Bad shard " << optarg << ", expected i/N with 0 <= i < N\n";
+				return 1;
+			}
+		break;
 		default:
 			std::cout << usageString << std::endl;
 			return 1;
@@ -91,7 +140,8 @@ int main(int argc, char* argv[]) {
 	
 	// TODO: Check Scene.pck.hash
 	
-	std::string outdir("Scene");
+	// Everything goes in outdir, sharded or not, so a shard can be merged from there with its manifest
+	std::string indexDir = outdir + "/";
 	
 	// Read pack header
 	ScenePackHeader header;
@@ -131,14 +181,14 @@ int main(int argc, char* argv[]) {
 	readStrings(fileStream, cmdNames, header.cmdNameIndex, header.cmdName, false);
 	readStrings(fileStream, sceneNames, header.sceneNameIndex, header.sceneName);
 	
-	std::ofstream outStream("SceneNames.txt");
+	std::ofstream outStream(indexDir + "SceneNames.txt");
 	outStream << sceneNames << std::endl << (varInfo + varNames) << std::endl << cmdNames;
 	outStream.close();
 	
 	// Write the global info
 	std::string name;
 	unsigned int count;
-	outStream.open("SceneInfo.dat", std::ios::out | std::ios::binary);
+	outStream.open(indexDir + "SceneInfo.dat", std::ios::out | std::ios::binary);
 		// scene names
 		count = sceneNames.size();
 		outStream.write((char*) &count, 4);
@@ -173,9 +223,35 @@ int main(int argc, char* argv[]) {
 		}
 	outStream.close();
 	
+	// Every shard writes the index files, only its own scenes
+	// Paths are relative to outdir, and only ones that stay inside it can be merged
+	auto isInside = [](const std::string& path) {
+		return !path.empty() && path[0] != '/' && path[0] != '\\' && path.find("..") == std::string::npos;
+	};
+	ShardManifest manifest;
+	manifest.shard = shard;
+	manifest.total = header.sceneNameIndex.count;
+	manifest.files.push_back("SceneNames.txt");
+	manifest.files.push_back("SceneInfo.dat");
+	auto extractStart = std::chrono::steady_clock::now();
+
+	std::vector<unsigned int> scenes;
+	if (shard.count > 1) {
+		std::vector<unsigned int> weights;
+		weights.reserve(header.sceneNameIndex.count);
+		for (unsigned int i = 0; i < header.sceneNameIndex.count; i++)
+			weights.push_back(sceneDataInfo.at(i).count);
+		scenes = shardItems(weights, shard);
+		Logger::Info() << "Shard " << std::to_string(shard.index) << "/" << std::to_string(shard.count) << " has " << std::to_string(scenes.size()) << " of " << std::to_string(header.sceneNameIndex.count) << " scenes.\n";
+	} else {
+		for (unsigned int i = 0; i < header.sceneNameIndex.count; i++)
+			scenes.push_back(i);
+	}
+
 	// Dump scene scripts
 	unsigned int offset;
-	for (unsigned int i = 0; i < header.sceneNameIndex.count; i++) {
+	for (const auto& i:scenes) {
+		auto sceneStart = std::chrono::steady_clock::now();
 		offset = header.sceneData.offset + sceneDataInfo.at(i).offset;
 		fileStream.seekg(offset);
 		unsigned char* buffer = new unsigned char[sceneDataInfo.at(i).count];
@@ -221,9 +297,27 @@ int main(int argc, char* argv[]) {
 		delete[] buffer;
 		delete[] decompressed;
 		outFile.close();
+
+		ShardEntry entry;
+		entry.position = i;
+		entry.name = sceneNames.at(i);
+		entry.milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - sceneStart).count();
+		manifest.entries.push_back(entry);
+		if (isInside(sceneNames.at(i)))
+			manifest.files.push_back(sceneNames.at(i) + ".ss");
+		else
+			Logger::Warn() << "Scene " << sceneNames.at(i) << " is outside " << outdir << ", leaving it out of the manifest.\n";
 	}
 
 	// Dump rest
+	// from the end of the scene data, whichever scenes this shard read
+	// Scenes needn't be stored in table order, so that's the furthest any of them goes
+	if (header.sceneNameIndex.count > 0) {
+		unsigned long long dataEnd = 0;
+		for (const auto& info:sceneDataInfo)
+			dataEnd = std::max(dataEnd, (unsigned long long) info.offset + info.count);
+		fileStream.seekg(header.sceneData.offset + dataEnd);
+	}
 	unsigned int pos = fileStream.tellg();
 	fileStream.ignore(std::numeric_limits<std::streamsize>::max());
 	unsigned int remainingLength = fileStream.gcount();
@@ -233,14 +327,23 @@ int main(int argc, char* argv[]) {
 	char* dumpBuf = new char[remainingLength];
 	fileStream.read(dumpBuf, remainingLength);
 	fileStream.close();
+	std::string dumpName = filename.substr(filename.find_last_of("/\\") + 1) + ".dump";
+	std::string dumpPath = indexDir + dumpName;
 	{
-		std::ofstream dumpStream(filename + ".dump", std::ios::out | std::ios::binary);
+		std::ofstream dumpStream(dumpPath, std::ios::out | std::ios::binary);
 		dumpStream.write(dumpBuf, remainingLength);
 		Logger::Info() << " Dumped remaining " << remainingLength << "bytes\n";
 		dumpStream.close();
 	}
 	delete[] dumpBuf;
 
+	if (shard.count > 1) {
+		if (isInside(dumpName))
+			manifest.files.push_back(dumpName);
+		manifest.milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - extractStart).count();
+		if (!manifest.write(outdir))
+			return 1;
+	}
 	
 
 	return 0;
@@ -0,0 +1,446 @@
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <chrono>
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "Server.h"
+#include "ThreadPool.h"
+#include "Logger.h"
+
+// What a file looked like when it was cached
+struct FileStamp {
+	long long mtime = 0;	// nanoseconds where the platform has them
+	long long size = 0;
+
+	bool operator==(const FileStamp& other) const {
+		return mtime == other.mtime && size == other.size;
+	}
+};
+
+static bool stampFile(const std::string& path, FileStamp& stamp) {
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return false;
+#ifdef __linux__
+	stamp.mtime = (long long) info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#else
+	stamp.mtime = (long long) info.st_mtime * 1000000000;
+#endif
+	stamp.size = info.st_size;
+	return true;
+}
+
+// FNV-1a of the whole file
+static bool hashFile(const std::string& path, uint64_t& hash) {
+	std::ifstream stream(path, std::ios::in | std::ios::binary);
+	if (!stream.is_open())
+		return false;
+
+	hash = 0xcbf29ce484222325ull;
+	char buffer[0x10000];
+	while (stream.read(buffer, sizeof(buffer)) || stream.gcount() > 0) {
+		for (std::streamsize i = 0; i < stream.gcount(); i++) {
+			hash ^= (unsigned char) buffer[i];
+			hash *= 0x100000001b3ull;
+		}
+	}
+	return true;
+}
+
+// Most recently used scenes, decoded and with whatever functions were already decompiled
+// An entry is dropped once its file's contents change; a new mtime with the same hash keeps it
+class SceneCache {
+	struct Entry {
+		std::shared_ptr<Scene> pScene;
+		FileStamp stamp;
+		uint64_t hash;
+		std::list<std::string>::iterator position;
+	};
+
+	const GlobalInfo& global;
+	int fileIndex;
+	unsigned int capacity;
+
+	std::mutex mutex;
+	std::map<std::string, Entry> entries;
+	std::list<std::string> order;	// most recent first
+
+	void touch(Entry& entry) {
+		order.splice(order.begin(), order, entry.position);
+	}
+	void erase(const std::string& path) {
+		auto it = entries.find(path);
+		if (it != entries.end()) {
+			order.erase(it->second.position);
+			entries.erase(it);
+		}
+	}
+	public:
+		SceneCache(const GlobalInfo& global_, int fileIndex_, unsigned int capacity_) : global(global_), fileIndex(fileIndex_), capacity(capacity_ > 0 ? capacity_ : 1) {}
+
+		// Throws if the scene cannot be read
+		std::shared_ptr<Scene> get(const std::string& path) {
+			FileStamp stamp;
+			if (!stampFile(path, stamp)) {
+				drop(path);
+				throw std::runtime_error("Could not open " + path);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto it = entries.find(path);
+				if (it != entries.end() && it->second.stamp == stamp) {
+					touch(it->second);
+					return it->second.pScene;
+				}
+			}
+
+			uint64_t hash;
+			if (!hashFile(path, hash))
+				throw std::runtime_error("Could not read " + path);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto it = entries.find(path);
+				if (it != entries.end()) {
+					if (it->second.hash == hash) {
+						// Only touched
+						it->second.stamp = stamp;
+						touch(it->second);
+						return it->second.pScene;
+					}
+					LOG_DEBUG() << "Dropping changed " << path << "\n";
+					erase(path);
+				}
+			}
+
+			// Keep asm too, so asm requests don't have to decompile again
+			auto pScene = std::make_shared<Scene>(path, global, fileIndex, true);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = entries.find(path);
+			if (it != entries.end()) {
+				// Someone else loaded it meanwhile
+				if (it->second.hash == hash) {
+					touch(it->second);
+					return it->second.pScene;
+				}
+				erase(path);
+			}
+
+			order.push_front(path);
+			Entry& entry = entries[path];
+			entry.pScene = pScene;
+			entry.stamp = stamp;
+			entry.hash = hash;
+			entry.position = order.begin();
+
+			while (order.size() > capacity)
+				erase(order.back());
+			return pScene;
+		}
+
+		void drop(const std::string& path) {
+			std::lock_guard<std::mutex> lock(mutex);
+			erase(path);
+		}
+		void clear() {
+			std::lock_guard<std::mutex> lock(mutex);
+			entries.clear();
+			order.clear();
+		}
+};
+
+// Where answers go; requests on one connection answer in whatever order they finish
+struct Connection {
+	std::mutex mutex;
+	std::function<void(const std::string&)> write;
+
+	void send(const std::string& response) {
+		std::lock_guard<std::mutex> lock(mutex);
+		write(response);
+	}
+};
+
+// Error messages go on one line, without colours
+static std::string errorLine(std::string message) {
+	std::string line;
+	for (unsigned int i = 0; i < message.size(); i++) {
+		if (message[i] == '\x1b') {
+			while (i < message.size() && message[i] != 'm')
+				i++;
+		} else if (message[i] == '\n' || message[i] == '\r') {
+			if (i + 1 < message.size())
+				line += ' ';
+		} else {
+			line += message[i];
+		}
+	}
+	return line;
+}
+
+// Throws std::runtime_error with what went wrong
+static std::string handleRequest(const std::vector<std::string>& args, SceneCache& cache, ThreadPool& pool) {
+	const std::string& command = args.at(0);
+	auto need = [&args, &command](unsigned int count) {
+		if (args.size() != count)
+			throw std::runtime_error("Wrong number of arguments for " + command);
+	};
+
+	if (command == "scene") {
+		need(2);
+		auto pScene = cache.get(args[1]);
+		pScene->decompileAll(&pool);
+		// Every function that worked, with a comment where one didn't
+		std::string source;
+		unsigned int firstTemporary = 0;
+		for (unsigned int i = 0; i < pScene->numTasks(); i++) {
+			const FunctionOutput& output = pScene->decompile(i);
+			if (output.error.empty()) {
+				source += numberTemporaries(output.source, firstTemporary);
+			} else {
+				std::string name = (i == 0) ? std::string("(entrypoints)") : pScene->getFunctions()[i - 1].name.str();
+				source += "\n// " + name + " failed: " + errorLine(output.error) + "\n";
+			}
+			firstTemporary += output.numTemporaries;
+		}
+		return source;
+	} else if (command == "function") {
+		need(3);
+		auto pScene = cache.get(args[1]);
+		const auto& functions = pScene->getFunctions();
+		for (unsigned int i = 0; i < functions.size(); i++) {
+			if (functions[i].name.str() != args[2])
+				continue;
+			const FunctionOutput& output = pScene->decompile(i + 1);
+			if (!output.error.empty())
+				throw std::runtime_error(output.error);
+			return numberTemporaries(output.source, 0);
+		}
+		throw std::runtime_error("No function " + args[2] + " in " + args[1]);
+	} else if (command == "asm") {
+		need(4);
+		unsigned int start, end;
+		try {
+			start = std::stoul(args[2], nullptr, 0);
+			end = std::stoul(args[3], nullptr, 0);
+		} catch (std::exception&) {
+			throw std::runtime_error("Bad address range " + args[2] + " " + args[3]);
+		}
+		auto pScene = cache.get(args[1]);
+		unsigned int numDone = pScene->decompileAll(&pool);
+		std::ostringstream lines;
+		pScene->writeAsm(lines, numDone, start, end);
+		return lines.str();
+	} else if (command == "drop") {
+		if (args.size() == 1)
+			cache.clear();
+		else
+			cache.drop(args.at(1));
+		return "";
+	}
+	throw std::runtime_error("Unknown request " + command);
+}
+
+static void runRequest(const std::string& request, SceneCache& cache, ThreadPool& pool, Connection& connection) {
+	std::istringstream fields(request);
+	std::string id;
+	std::vector<std::string> args;
+	fields >> id;
+	for (std::string arg; fields >> arg;)
+		args.push_back(arg);
+
+	auto start = std::chrono::steady_clock::now();
+	std::ostringstream log;
+	std::string response;
+	{
+		// Anything logged is only useful if it went wrong
+		Logger::Redirect redirect(log);
+		try {
+			if (args.empty())
+				throw std::runtime_error("Empty request");
+			std::string payload = handleRequest(args, cache, pool);
+			response = id + " ok " + std::to_string(payload.size()) + "\n" + payload;
+		} catch (std::runtime_error& e) {
+			response = id + " error " + errorLine(e.what()) + "\n";
+		} catch (std::exception& e) {
+			std::string message = log.str().empty() ? e.what() : log.str();
+			response = id + " error " + errorLine(message) + "\n";
+		}
+	}
+	connection.send(response);
+
+	long long milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	LOG_DEBUG() << request << ": " << std::to_string(milliseconds) << " ms\n";
+}
+
+// Reads requests with readLine until it fails, running each on the pool
+static void serveConnection(const std::function<bool(std::string&)>& readLine, std::shared_ptr<Connection> pConnection, SceneCache& cache, ThreadPool& pool) {
+	std::string line;
+	while (readLine(line)) {
+		if (line.empty() || line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+		pool.submit([line, pConnection, &cache, &pool]() {
+			runRequest(line, cache, pool, *pConnection);
+		});
+	}
+}
+
+#ifndef _WIN32
+
+static bool writeAll(int fd, const std::string& data) {
+	const char* p = data.data();
+	size_t length = data.size();
+	while (length > 0) {
+		ssize_t n = write(fd, p, length);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		length -= n;
+	}
+	return true;
+}
+
+static int serveSocket(const std::string& path, SceneCache& cache, ThreadPool& pool) {
+	int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (listenFd < 0 || path.size() >= sizeof(address.sun_path)) {
+		Logger::Error() << "Could not create socket " << path << std::endl;
+		return 1;
+	}
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+	// Left over from a previous server
+	unlink(path.c_str());
+	if (bind(listenFd, (sockaddr*) &address, sizeof(address)) != 0 || listen(listenFd, 16) != 0) {
+		Logger::Error() << "Could not listen on " << path << ": " << strerror(errno) << std::endl;
+		close(listenFd);
+		return 1;
+	}
+	Logger::Info() << "Listening on " << path << "\n";
+
+	// Each connection's reader, all joined before cache and pool can go away
+	struct Reader {
+		std::thread thread;
+		int fd;
+		std::shared_ptr<Connection> pConnection;	// keeps fd open until the reader is joined
+		std::shared_ptr<std::atomic<bool>> pDone;
+	};
+	std::vector<Reader> readers;
+
+	while (true) {
+		int fd = accept(listenFd, nullptr, nullptr);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			Logger::Error() << "Accept failed: " << strerror(errno) << std::endl;
+			break;
+		}
+
+		for (auto it = readers.begin(); it != readers.end();) {
+			if (*it->pDone) {
+				it->thread.join();
+				it = readers.erase(it);
+			} else {
+				it++;
+			}
+		}
+
+		// The connection lives until its reader and every request on it are done
+		std::shared_ptr<Connection> pConnection(new Connection, [fd](Connection* p) {
+			close(fd);
+			delete p;
+		});
+		pConnection->write = [fd](const std::string& response) {
+			writeAll(fd, response);
+		};
+
+		auto pDone = std::make_shared<std::atomic<bool>>(false);
+		std::thread thread([fd, pConnection, pDone, &cache, &pool]() {
+			std::string buffer;
+			auto readLine = [fd, &buffer](std::string& line) {
+				size_t newline;
+				while ((newline = buffer.find('\n')) == std::string::npos) {
+					char chunk[0x1000];
+					ssize_t n = read(fd, chunk, sizeof(chunk));
+					if (n < 0 && errno == EINTR)
+						continue;
+					if (n <= 0)
+						return false;
+					buffer.append(chunk, n);
+				}
+				line = buffer.substr(0, newline);
+				buffer.erase(0, newline + 1);
+				return true;
+			};
+			serveConnection(readLine, pConnection, cache, pool);
+			*pDone = true;
+		});
+		readers.push_back(Reader{std::move(thread), fd, pConnection, pDone});
+	}
+
+	// Wake the readers still waiting on their clients
+	for (auto& reader:readers) {
+		shutdown(reader.fd, SHUT_RD);
+		reader.thread.join();
+	}
+	close(listenFd);
+	unlink(path.c_str());
+	return 1;
+}
+
+#else
+
+static int serveSocket(const std::string&, SceneCache&, ThreadPool&) {
+	Logger::Error() << "Sockets are not supported on Windows, serve stdin instead.\n";
+	return 1;
+}
+
+#endif
+
+int serve(const GlobalInfo& global, const DecompileOptions& options, const ServeOptions& serveOptions) {
+#ifndef _WIN32
+	// A client hanging up shouldn't take the server with it
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	SceneCache cache(global, options.fileIndex, serveOptions.cacheSize);
+	ThreadPool pool(serveOptions.numThreads);
+	Logger::Info() << "Serving with " << std::to_string(pool.size()) << " threads, caching " << std::to_string(serveOptions.cacheSize) << " scenes.\n";
+
+	if (!serveOptions.socketPath.empty())
+		return serveSocket(serveOptions.socketPath, cache, pool);
+
+	auto pConnection = std::make_shared<Connection>();
+	pConnection->write = [](const std::string& response) {
+		std::cout << response << std::flush;
+	};
+	serveConnection([](std::string& line) {
+		return (bool) std::getline(std::cin, line);
+	}, pConnection, cache, pool);
+
+	// The pool finishes whatever is still queued on the way out
+	return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+
+#include "Decompiler.h"
+
+struct ServeOptions {
+	std::string socketPath;		// empty to serve stdin/stdout
+	unsigned int cacheSize = 32;	// scenes kept decoded
+	unsigned int numThreads = 0;	// 0 uses one per core
+};
+
+// Answers requests, one per line, until stdin closes (or forever on a socket)
+//   <id> scene <file>                   whole scene source, with a comment for each function that failed
+//   <id> function <file> <name>         one function's source, its temporaries numbered from var0
+//   <id> asm <file> <start> <end>       assembler for addresses in [start, end]
+//   <id> drop [file]                    forget a scene, or all of them
+// Each answer starts with "<id> ok <length>\n" followed by length bytes, or is "<id> error <message>\n"
+// Requests run concurrently, so answers can come back in any order
+// Recently used scenes stay decoded, with their finished functions, until the file changes
+int serve(const GlobalInfo& global, const DecompileOptions& options, const ServeOptions& serveOptions);
+
+#endif
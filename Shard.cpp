@@ -0,0 +1,269 @@
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+
+#include <sys/stat.h>
+#include <dirent.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "Shard.h"
+#include "Logger.h"
+
+bool Shard::parse(const std::string& spec) {
+	size_t slash = spec.find('/');
+	if (slash == std::string::npos)
+		return false;
+	try {
+		index = std::stoul(spec.substr(0, slash));
+		count = std::stoul(spec.substr(slash + 1));
+	} catch (std::exception&) {
+		return false;
+	}
+	return count > 0 && index < count;
+}
+
+std::string Shard::name() const {
+	return "shard-" + std::to_string(index) + "-of-" + std::to_string(count);
+}
+
+std::vector<unsigned int> shardItems(const std::vector<unsigned int>& weights, const Shard& shard) {
+	std::vector<unsigned int> order(weights.size());
+	for (unsigned int i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&weights](unsigned int a, unsigned int b) {
+		return weights[a] > weights[b];
+	});
+
+	// Ties go to the lowest shard, so the split only depends on the weights
+	std::vector<unsigned long long> load(shard.count, 0);
+	std::vector<unsigned int> items;
+	for (const auto& item:order) {
+		unsigned int lightest = std::min_element(load.begin(), load.end()) - load.begin();
+		// Empty items still count for something, or they'd all pile onto one shard
+		load[lightest] += std::max(weights[item], 1u);
+		if (lightest == shard.index)
+			items.push_back(item);
+	}
+	std::sort(items.begin(), items.end());
+	return items;
+}
+
+std::string ShardManifest::filename() const {
+	return shard.name() + ".manifest";
+}
+
+// Fields are tab separated, so keep tabs and newlines out of them
+static std::string flatten(std::string field) {
+	std::replace(field.begin(), field.end(), '\t', ' ');
+	std::replace(field.begin(), field.end(), '\n', ' ');
+	std::replace(field.begin(), field.end(), '\r', ' ');
+	return field;
+}
+
+bool ShardManifest::write(const std::string& dir) const {
+	std::string path = dir + "/" + filename();
+	std::ofstream stream(path);
+	if (!stream.is_open()) {
+		Logger::Error() << "Could not write manifest " << path << std::endl;
+		return false;
+	}
+
+	stream << "shard\t" << shard.index << "\t" << shard.count << "\t" << total << "\t" << milliseconds << "\n";
+	for (const auto& entry:entries)
+		stream << "entry\t" << entry.position << "\t" << entry.milliseconds << "\t" << flatten(entry.name) << "\t" << flatten(entry.error) << "\n";
+	for (const auto& file:files)
+		stream << "file\t" << flatten(file) << "\n";
+
+	return stream.good();
+}
+
+bool ShardManifest::read(const std::string& path) {
+	std::ifstream stream(path);
+	if (!stream.is_open()) {
+		Logger::Error() << "Could not open manifest " << path << std::endl;
+		return false;
+	}
+
+	bool haveHeader = false;
+	std::string line;
+	while (std::getline(stream, line)) {
+		std::istringstream fields(line);
+		std::string kind;
+		std::getline(fields, kind, '\t');
+		if (kind == "shard") {
+			fields >> shard.index >> shard.count >> total >> milliseconds;
+			haveHeader = !fields.fail() && shard.count > 0 && shard.index < shard.count;
+		} else if (kind == "entry") {
+			ShardEntry entry;
+			fields >> entry.position >> entry.milliseconds;
+			fields.ignore(1);
+			std::getline(fields, entry.name, '\t');
+			std::getline(fields, entry.error);
+			entries.push_back(entry);
+		} else if (kind == "file") {
+			std::string file;
+			std::getline(fields, file);
+			files.push_back(file);
+		} else if (!kind.empty()) {
+			haveHeader = false;
+			break;
+		}
+	}
+
+	if (!haveHeader) {
+		Logger::Error() << "Bad manifest " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static std::vector<std::string> findManifests(const std::string& dir) {
+	std::vector<std::string> manifests;
+	DIR* pDir = opendir(dir.c_str());
+	if (pDir == nullptr)
+		return manifests;
+
+	while (dirent* entry = readdir(pDir)) {
+		std::string name(entry->d_name);
+		if (name.compare(0, 6, "shard-") == 0 && name.size() > 9 && name.compare(name.size() - 9, 9, ".manifest") == 0)
+			manifests.push_back(dir + "/" + name);
+	}
+	closedir(pDir);
+
+	std::sort(manifests.begin(), manifests.end());
+	return manifests;
+}
+
+bool makeDirectory(const std::string& path) {
+#ifdef _WIN32
+	_mkdir(path.c_str());
+#else
+	mkdir(path.c_str(), 0777);
+#endif
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+// Makes every directory up to the file
+static bool makeParents(const std::string& path) {
+	size_t slash = 0;
+	while ((slash = path.find('/', slash + 1)) != std::string::npos) {
+		if (!makeDirectory(path.substr(0, slash)))
+			return false;
+	}
+	return true;
+}
+
+static bool readFile(const std::string& path, std::string& contents) {
+	std::ifstream stream(path, std::ios::in | std::ios::binary);
+	if (!stream.is_open())
+		return false;
+	std::ostringstream buffer;
+	buffer << stream.rdbuf();
+	contents = buffer.str();
+	return true;
+}
+
+bool mergeShards(const std::vector<std::string>& shardDirs, const std::string& outDir, ShardManifest& merged) {
+	merged = ShardManifest();
+
+	std::map<unsigned int, std::string> shardPaths;		// shard index, manifest it came from
+	std::map<std::string, std::string> copied;		// output file, shard it came from
+	std::vector<bool> seen;
+	bool first = true;
+
+	for (const auto& dir:shardDirs) {
+		std::vector<std::string> manifests = findManifests(dir);
+		if (manifests.empty()) {
+			Logger::Error() << "No shard manifest in " << dir << std::endl;
+			return false;
+		}
+
+		for (const auto& path:manifests) {
+			ShardManifest manifest;
+			if (!manifest.read(path))
+				return false;
+
+			if (first) {
+				merged.shard.count = manifest.shard.count;
+				merged.total = manifest.total;
+				seen.assign(merged.total, false);
+				first = false;
+			} else if (manifest.shard.count != merged.shard.count || manifest.total != merged.total) {
+				Logger::Error() << path << " is from a different batch (" << std::to_string(manifest.shard.count) << " shards of " << std::to_string(manifest.total) << ", expected " << std::to_string(merged.shard.count) << " of " << std::to_string(merged.total) << ")\n";
+				return false;
+			}
+
+			auto inserted = shardPaths.insert(std::make_pair(manifest.shard.index, path));
+			if (!inserted.second) {
+				Logger::Error() << "Shard " << std::to_string(manifest.shard.index) << " is in both " << inserted.first->second << " and " << path << std::endl;
+				return false;
+			}
+
+			for (const auto& entry:manifest.entries) {
+				if (entry.position >= merged.total || seen[entry.position]) {
+					Logger::Error() << path << ": " << entry.name << " is out of range or already merged.\n";
+					return false;
+				}
+				seen[entry.position] = true;
+				merged.entries.push_back(entry);
+			}
+
+			for (const auto& file:manifest.files) {
+				std::string contents;
+				if (!readFile(dir + "/" + file, contents)) {
+					Logger::Error() << "Missing output " << dir << "/" << file << std::endl;
+					return false;
+				}
+
+				std::string outPath = outDir + "/" + file;
+				auto it = copied.find(file);
+				if (it != copied.end()) {
+					// Written by another shard already, so it should be the same
+					std::string existing;
+					if (!readFile(outPath, existing) || existing != contents) {
+						Logger::Error() << file << " differs between " << it->second << " and " << path << std::endl;
+						return false;
+					}
+					continue;
+				}
+
+				if (!makeParents(outPath)) {
+					Logger::Error() << "Could not create directory for " << outPath << std::endl;
+					return false;
+				}
+				std::ofstream out(outPath, std::ios::out | std::ios::binary);
+				out.write(contents.data(), contents.size());
+				if (!out.good()) {
+					Logger::Error() << "Could not write " << outPath << std::endl;
+					return false;
+				}
+				copied[file] = path;
+			}
+
+			merged.milliseconds = std::max(merged.milliseconds, manifest.milliseconds);
+		}
+	}
+
+	if (shardPaths.size() != merged.shard.count) {
+		std::string missing;
+		for (unsigned int i = 0; i < merged.shard.count; i++) {
+			if (shardPaths.count(i) == 0)
+				missing += " " + std::to_string(i);
+		}
+		Logger::Error() << "Only have " << std::to_string(shardPaths.size()) << " of " << std::to_string(merged.shard.count) << " shards, missing" << missing << std::endl;
+		return false;
+	}
+	if (std::find(seen.begin(), seen.end(), false) != seen.end()) {
+		Logger::Error() << "Shards do not cover the whole batch.\n";
+		return false;
+	}
+
+	std::sort(merged.entries.begin(), merged.entries.end(), [](const ShardEntry& a, const ShardEntry& b) {
+		return a.position < b.position;
+	});
+	return true;
+}
@@ -0,0 +1,50 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <string>
+#include <vector>
+
+// One of count roughly equal slices of a batch, for spreading it over machines
+struct Shard {
+	unsigned int index = 0;
+	unsigned int count = 1;
+
+	// "i/N" with 0 <= i < N
+	bool parse(const std::string& spec);
+	std::string name() const;
+};
+
+// Picks the items (by position, in order) that belong to a shard
+// Biggest first onto the lightest shard, so every machine computes the same split without talking to the others
+std::vector<unsigned int> shardItems(const std::vector<unsigned int>& weights, const Shard& shard);
+
+struct ShardEntry {
+	unsigned int position = 0;	// in the whole batch
+	std::string name;
+	long long milliseconds = 0;
+	std::string error;
+};
+
+// What one shard did, written next to its outputs so the shards can be merged later
+struct ShardManifest {
+	Shard shard;
+	unsigned int total = 0;		// items in the whole batch
+	long long milliseconds = 0;
+	std::vector<ShardEntry> entries;
+	// Outputs, relative to the directory the manifest is in
+	// Files written by every shard (indexes) have to come out the same on each
+	std::vector<std::string> files;
+
+	std::string filename() const;
+	bool write(const std::string& dir) const;
+	bool read(const std::string& path);
+};
+
+// Creates the directory if it isn't there, its parent has to be
+bool makeDirectory(const std::string& path);
+
+// Copies the outputs of every shard found in shardDirs into outDir and checks that all shards are there
+// merged gets every entry in batch order, and the time of the slowest shard
+bool mergeShards(const std::vector<std::string>& shardDirs, const std::string& outDir, ShardManifest& merged);
+
+#endif
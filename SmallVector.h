@@ -0,0 +1,212 @@
+#ifndef SMALLVECTOR_H
+#define SMALLVECTOR_H
+
+#include <cstddef>
+#include <new>
+#include <algorithm>
+#include <utility>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <initializer_list>
+
+// Vector that keeps its first N elements inside itself, and only goes to the heap past that
+// For the many short lists the IR has (call arguments, block edges) which are nearly always a handful long
+// Only what the decompiler uses of std::vector, and like it, anything that adds can move the elements
+template <typename T, unsigned int N>
+class SmallVector {
+	T* pData;
+	unsigned int count = 0;
+	unsigned int capacity = N;
+	typename std::aligned_storage<sizeof(T), alignof(T)>::type inlineData[N];
+
+	T* inlineBuffer() { return reinterpret_cast<T*>(inlineData); }
+	bool isInline() const { return pData == reinterpret_cast<const T*>(inlineData); }
+
+	void grow(unsigned int minCapacity) {
+		unsigned int newCapacity = capacity * 2;
+		if (newCapacity < minCapacity)
+			newCapacity = minCapacity;
+
+		T* pNew = static_cast<T*>(::operator new(newCapacity * sizeof(T)));
+		for (unsigned int i = 0; i < count; i++) {
+			new (pNew + i) T(std::move(pData[i]));
+			pData[i].~T();
+		}
+		if (!isInline())
+			::operator delete(pData);
+		pData = pNew;
+		capacity = newCapacity;
+	}
+
+	// Takes other's elements, leaving it empty
+	void steal(SmallVector& other) {
+		if (other.isInline()) {
+			for (unsigned int i = 0; i < other.count; i++) {
+				new (pData + i) T(std::move(other.pData[i]));
+				other.pData[i].~T();
+			}
+		} else {
+			pData = other.pData;
+			capacity = other.capacity;
+			other.pData = other.inlineBuffer();
+			other.capacity = N;
+		}
+		count = other.count;
+		other.count = 0;
+	}
+
+	public:
+		typedef T value_type;
+		typedef T* iterator;
+		typedef const T* const_iterator;
+		typedef std::reverse_iterator<iterator> reverse_iterator;
+		typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+		SmallVector() : pData(inlineBuffer()) {}
+		SmallVector(std::initializer_list<T> list) : pData(inlineBuffer()) {
+			reserve(list.size());
+			for (const auto& value:list)
+				push_back(value);
+		}
+		SmallVector(const SmallVector& other) : pData(inlineBuffer()) {
+			reserve(other.count);
+			for (const auto& value:other)
+				push_back(value);
+		}
+		SmallVector(SmallVector&& other) : pData(inlineBuffer()) {
+			steal(other);
+		}
+		~SmallVector() {
+			clear();
+			if (!isInline())
+				::operator delete(pData);
+		}
+
+		SmallVector& operator =(const SmallVector& other) {
+			if (this != &other) {
+				clear();
+				reserve(other.count);
+				for (const auto& value:other)
+					push_back(value);
+			}
+			return *this;
+		}
+		SmallVector& operator =(SmallVector&& other) {
+			if (this != &other) {
+				clear();
+				if (!isInline()) {
+					::operator delete(pData);
+					pData = inlineBuffer();
+					capacity = N;
+				}
+				steal(other);
+			}
+			return *this;
+		}
+
+		bool operator ==(const SmallVector& other) const {
+			if (count != other.count)
+				return false;
+			for (unsigned int i = 0; i < count; i++) {
+				if (!(pData[i] == other.pData[i]))
+					return false;
+			}
+			return true;
+		}
+		bool operator !=(const SmallVector& other) const { return !(*this == other); }
+
+		unsigned int size() const { return count; }
+		bool empty() const { return count == 0; }
+		void reserve(unsigned int minCapacity) {
+			if (minCapacity > capacity)
+				grow(minCapacity);
+		}
+
+		T& operator [](unsigned int i) { return pData[i]; }
+		const T& operator [](unsigned int i) const { return pData[i]; }
+		T& at(unsigned int i) {
+			if (i >= count)
+				throw std::out_of_range("SmallVector index out of range");
+			return pData[i];
+		}
+		const T& at(unsigned int i) const {
+			if (i >= count)
+				throw std::out_of_range("SmallVector index out of range");
+			return pData[i];
+		}
+		T& front() { return pData[0]; }
+		const T& front() const { return pData[0]; }
+		T& back() { return pData[count - 1]; }
+		const T& back() const { return pData[count - 1]; }
+
+		iterator begin() { return pData; }
+		iterator end() { return pData + count; }
+		const_iterator begin() const { return pData; }
+		const_iterator end() const { return pData + count; }
+		reverse_iterator rbegin() { return reverse_iterator(end()); }
+		reverse_iterator rend() { return reverse_iterator(begin()); }
+		const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+		const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+		void push_back(const T& value) {
+			if (count == capacity) {
+				// value could be one of ours
+				T copy(value);
+				grow(count + 1);
+				new (pData + count) T(std::move(copy));
+			} else {
+				new (pData + count) T(value);
+			}
+			count++;
+		}
+		void push_back(T&& value) {
+			if (count == capacity) {
+				T moved(std::move(value));
+				grow(count + 1);
+				new (pData + count) T(std::move(moved));
+			} else {
+				new (pData + count) T(std::move(value));
+			}
+			count++;
+		}
+		template <typename... Args>
+		void emplace_back(Args&&... args) {
+			if (count == capacity)
+				grow(count + 1);
+			new (pData + count) T(std::forward<Args>(args)...);
+			count++;
+		}
+		void pop_back() {
+			pData[--count].~T();
+		}
+		void clear() {
+			for (unsigned int i = 0; i < count; i++)
+				pData[i].~T();
+			count = 0;
+		}
+
+		// Removes [first, last), moving the rest down
+		iterator erase(const_iterator first, const_iterator last) {
+			iterator pFirst = begin() + (first - begin());
+			iterator pLast = begin() + (last - begin());
+			iterator pEnd = std::move(pLast, end(), pFirst);
+			for (iterator it = pEnd; it != end(); it++)
+				it->~T();
+			count = pEnd - begin();
+			return pFirst;
+		}
+		iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+
+		// Only appends, which is all the callers do
+		template <typename InputIt>
+		void insert(const_iterator pos, InputIt first, InputIt last) {
+			if (pos != end())
+				throw std::logic_error("SmallVector can only insert at the end");
+			reserve(count + std::distance(first, last));
+			for (; first != last; first++)
+				push_back(*first);
+		}
+};
+
+#endif
@@ -4,36 +4,50 @@
 
 Stack::Stack() : stackHeights({0}) {}
 
-Stack::Stack(const Stack& copy) : stackHeights(copy.stackHeights) {
-	for (const auto& value:copy.values) {
-		values.emplace_back(value->clone());
-	}
+Stack::~Stack() {
+	unlink(std::move(top));
 }
 
-
-// TODO: swap, but its not like anything can go wrong here
-Stack& Stack::operator=(const Stack& copy) {
-	if (this == &copy)
-		return *this;
-
-	stackHeights = copy.stackHeights;
-	values.clear();
-	for (const auto& value:copy.values) {
-		values.emplace_back(value->clone());
+Stack& Stack::operator =(const Stack& other) {
+	if (this != &other) {
+		unlink(std::move(top));
+		top = other.top;
+		stackHeights = other.stackHeights;
 	}
+	return *this;
+}
 
+Stack& Stack::operator =(Stack&& other) {
+	if (this != &other) {
+		unlink(std::move(top));
+		top = std::move(other.top);
+		stackHeights = std::move(other.stackHeights);
+	}
 	return *this;
 }
 
+void Stack::unlink(std::shared_ptr<Node> node) {
+	while (node && node.use_count() == 1) {
+		std::shared_ptr<Node> next = std::move(node->next);
+		// Sources never have sources of their own, so this only goes one deep
+		if (node->source)
+			unlink(std::move(node->source));
+		node = std::move(next);
+	}
+}
+
 // Takes ownership of raw pointer
 void Stack::push(Expression* pValue) {
-	values.emplace_back(pValue);
-	height()++;
-
-	if (back() == nullptr) {
+	if (pValue == nullptr) {
 		Logger::Error() << "Nullptr placed onto stack.\n";
 		throw std::logic_error("NULL on stack.");
 	}
+
+	std::shared_ptr<Node> node = std::make_shared<Node>();
+	node->value = Value(pValue);
+	node->next = std::move(top);
+	top = std::move(node);
+	height()++;
 }
 
 
@@ -44,24 +58,41 @@ Value Stack::pop() {
 	if (height() == 0)
 		throw std::logic_error("Popping empty frame.");
 
-	Value pExpr = std::move(back());
-	values.pop_back();
+	// Only take the expression if no other stack can see it
+	Value pExpr;
+	if (top.use_count() == 1 && top->value != nullptr)
+		pExpr = std::move(top->value);
+	else
+		pExpr = Value(top->get()->clone());
+
+	dropTop();
 	height()--;
 
 	return pExpr;
 }
 
+void Stack::dropTop() {
+	std::shared_ptr<Node> old = std::move(top);
+	top = old->next;
+	unlink(std::move(old));
+}
+
 void Stack::openFrame() {
 	stackHeights.push_back(0);
 }
 
-std::vector<Value>::iterator Stack::getFrame() {
-	return values.end() - height();
+std::vector<Value> Stack::takeFrame() {
+	std::vector<Value> frame(height());
+	for (auto it = frame.rbegin(); it != frame.rend(); it++)
+		*it = pop();
+	closeFrame();
+	return frame;
 }
 
 
 void Stack::closeFrame() {
-	values.erase(values.end() - height(), values.end());
+	for (unsigned int i = 0; i < height(); i++)
+		dropTop();
 	stackHeights.pop_back();
 	// 
 	if (stackHeights.empty())
@@ -70,16 +101,32 @@ void Stack::closeFrame() {
 
 void Stack::duplicateElement() {
 	unsigned int count = stackHeights.back();
-	stackHeights.push_back(0);
-	for (unsigned int i = 0; i < count; i++) {
-		push(values.at(values.size() - count)->clone());
+	std::vector<std::shared_ptr<Node>> frame(count);
+	std::shared_ptr<Node> node = top;
+	for (auto it = frame.rbegin(); it != frame.rend(); it++) {
+		if (node == nullptr)
+			throw std::out_of_range("Duplicating past the bottom of the stack.");
+		*it = node->source ? node->source : node;
+		node = node->next;
+	}
+
+	stackHeights.push_back(count);
+	for (auto& source:frame) {
+		node = std::make_shared<Node>();
+		node->source = std::move(source);
+		node->next = std::move(top);
+		top = std::move(node);
 	}
 }
 
-std::string Stack::print() {
+std::string Stack::print() const {
+	std::vector<const Expression*> values;
+	for (Node* pNode = top.get(); pNode != nullptr; pNode = pNode->next.get())
+		values.push_back(pNode->get());
+
 	std::string str;
-	for (const auto& value:values) {
-		str += value->print() + " (" + VarType(value->getType()) + ") \n";
+	for (auto it = values.rbegin(); it != values.rend(); it++) {
+		str += (*it)->print() + " (" + VarType((*it)->getType()) + ") \n";
 	}
 	return str;
-}
\ No newline at end of file
+}
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 
 #include "ControlFlow.h"
 #include "Statements.h"
@@ -119,9 +120,6 @@ SwitchStatement* IfStatement::doFoldSwitch() {
 	if (branches.size() < 3)
 		return nullptr;
 
-	std::vector<IfBranch> switches;
-
-
 	auto pBranch = branches.rbegin();
 	// original condition not moved
 	Value& pOrigCond = pBranch->condition;
@@ -131,38 +129,40 @@ SwitchStatement* IfStatement::doFoldSwitch() {
 	if (pOrigCond->exprType != Expression::BOOL_EXPR)
 		return nullptr;
 
-	// comp goes out of scope if exit
 	BinaryExpression* comp = static_cast<BinaryExpression*>(pOrigCond.get());
 	if (!comp->isEquality())
 		return nullptr;
 
 	Value* pOrig = &comp->getLHS();
-	std::string exprName = (*pOrig)->print();
-	// cloned value will be deleted safely if exit
-	// statements only have one copy in original branch if exit
-	switches.push_back(IfBranch(Value(comp->getRHS()->clone()), pBranch->block));
-	switches.back().lineNum = pBranch->lineNum;
 
+	// Check every branch first, so nothing has been taken apart if this isn't a switch
 	while (++pBranch != branches.rend()) {
 		Value& pExpr = pBranch->condition;
-		if (pExpr == nullptr) {
-			switches.push_back(IfBranch(Value(), pBranch->block));
-		} else if (pExpr->exprType != Expression::BOOL_EXPR) {
+		if (pExpr == nullptr)
+			continue;
+		if (pExpr->exprType != Expression::BOOL_EXPR)
+			return nullptr;
+
+		comp = static_cast<BinaryExpression*>(pExpr.get());
+		if (!comp->isEquality())
 			return nullptr;
-		} else {
-			comp = static_cast<BinaryExpression*>(pExpr.get());
-			if (!comp->isEquality())
-				return nullptr;
 
-			if (comp->getLHS()->print() != exprName)
-				return nullptr;
+		if (!comp->getLHS()->equals(**pOrig))
+			return nullptr;
+	}
 
-			switches.push_back(IfBranch(Value(comp->getRHS()->clone()), pBranch->block));
+	// The tested values move into the cases, the rest of each condition goes with the if statement
+	std::vector<IfBranch> switches;
+	for (pBranch = branches.rbegin(); pBranch != branches.rend(); pBranch++) {
+		if (pBranch->condition == nullptr) {
+			switches.push_back(IfBranch(Value(), pBranch->block));
+		} else {
+			comp = static_cast<BinaryExpression*>(pBranch->condition.get());
+			switches.push_back(IfBranch(std::move(comp->getRHS()), pBranch->block));
 			switches.back().lineNum = pBranch->lineNum;
 		}
 	}
 
-	// "Check?" for success - skip
 	// Move test expression
 	SwitchStatement* pSwitch = new SwitchStatement(std::move(*pOrig), std::move(switches));
 	// Detach statements from if branches
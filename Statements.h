@@ -5,6 +5,9 @@
 
 #include "Logger.h"
 #include "Helper.h"
+#include "Arena.h"
+#include "SmallVector.h"
+#include "Symbol.h"
 
 namespace ValueType {
 	const unsigned int UNDEF               = 0xFFFFFFFF;
@@ -68,6 +71,9 @@ enum IntType {
 class Expression;
 class Statement;
 typedef std::unique_ptr<Expression> Value;
+// Call arguments and the like, hardly ever more than a few
+typedef SmallVector<Value, 4> ValueList;
+typedef SmallVector<unsigned int, 4> TypeList;
 typedef std::vector<Statement*> StatementBlock;
 
 
@@ -76,6 +82,7 @@ void negateCondition(Value& cond);
 class Expression {
 	private:
 		int lineNum = -1;
+		mutable size_t cachedHash = 0;	// 0 until first asked for
 	protected:
 		unsigned int type = ValueType::UNDEF;
 		int listLength = 0;
@@ -85,12 +92,23 @@ class Expression {
 		virtual ~Expression() {}
 		virtual Expression* clone() const = 0;
 
+		// Out of the thread's arena while a function is being decompiled
+		static void* operator new(size_t size) { return Arena::allocateNode(size); }
+		static void operator delete(void* p) { Arena::freeNode(p); }
+
 		unsigned int getType() const { return type; }
 		void setType(unsigned int type_) {
 			type = type_;
+			cachedHash = 0;
 		}
 
-		virtual bool hasSideEffect() { return false; }
+		// Structural hash and equality, two expressions are equal if they are the same kind of node over equal children
+		// The hash is cached, so a node shouldn't change once it has been hashed (apart from setType and negateBool)
+		// Handing out a child to change clears the node's own cache, but not its parents', so children of hashed nodes are left alone
+		size_t hash() const;
+		bool equals(const Expression& other) const;
+
+		virtual bool hasSideEffect() const { return false; }
 		virtual std::string print(bool hex=false) const;
 
 
@@ -111,6 +129,21 @@ class Expression {
 		ExpressionType exprType = INVALID;
 
 		virtual int getPrecedence() const { return 0xFF; };
+
+	protected:
+		void rehash() { cachedHash = 0; }
+		// What the node itself adds to the hash, and the comparison against a node of the same class
+		// Every kind of node has to say, so none is mistaken for another of its class by default
+		virtual size_t hashNode() const = 0;
+		virtual bool equalNode(const Expression& other) const = 0;
+};
+
+// For unordered containers of expressions, compared by structure rather than by address
+struct ExpressionHash {
+	size_t operator()(const Expression* pExpr) const { return pExpr->hash(); }
+};
+struct ExpressionEqual {
+	bool operator()(const Expression* a, const Expression* b) const { return a->equals(*b); }
 };
 
 class BinaryExpression: public Expression {
@@ -124,17 +157,20 @@ class BinaryExpression: public Expression {
 		virtual BinaryExpression* clone() const override { return new BinaryExpression(*this); }
 
 		std::string print(bool hex=false) const override;
-		bool hasSideEffect() override { return expr1->hasSideEffect() || expr2->hasSideEffect(); }
+		bool hasSideEffect() const override { return expr1->hasSideEffect() || expr2->hasSideEffect(); }
 		IntType getIntType() override { return (type == ValueType::INT) ? IntegerSimple : IntegerInvalid; }
 
 	public:
 		void negateBool();
 		bool isEquality() { return op == 0x11; }
-		Value& getLHS() { return expr1; }
-		Value& getRHS() { return expr2; }
+		Value& getLHS() { rehash(); return expr1; }
+		Value& getRHS() { rehash(); return expr2; }
 
 		virtual int getPrecedence() const override;
 
+	protected:
+		size_t hashNode() const override;
+		bool equalNode(const Expression& other) const override;
 };
 
 class UnaryExpression: public Expression {
@@ -147,11 +183,14 @@ class UnaryExpression: public Expression {
 		virtual UnaryExpression* clone() const override { return new UnaryExpression(*this); }
 
 		std::string print(bool hex=false) const override;
-		bool hasSideEffect() override { return expr->hasSideEffect(); }
+		bool hasSideEffect() const override { return expr->hasSideEffect(); }
 		IntType getIntType() override { return (type == ValueType::INT) ? IntegerSimple : IntegerInvalid; }
 
 		virtual int getPrecedence() const override;
 
+	protected:
+		size_t hashNode() const override;
+		bool equalNode(const Expression& other) const override;
 };
 
 class IndexValueExpr: public BinaryExpression {
@@ -183,48 +222,72 @@ class RawValueExpr: public Expression {
 		std::string print(bool hex=false) const override;
 		IntType getIntType() override;
 		unsigned int getIndex() override { return (value & 0x00FFFFFF); };
+
+	protected:
+		size_t hashNode() const override;
+		bool equalNode(const Expression& other) const override;
+};
+
+// A global or static variable, read once with the scene info and shared (read only) from then on
+struct VariableInfo {
+	Symbol name;
+	unsigned int type;
+	unsigned int length;
+
+	VariableInfo(Symbol name, unsigned int type, unsigned int length);
 };
 
 class VariableExpression: public Expression {
 	private:
-		static unsigned int varCount;
-
-		std::string name;
+		Symbol name;
 		VariableExpression() {}
 	public:
-		VariableExpression(std::string name, unsigned int type, unsigned int length = 0);
-		VariableExpression(unsigned int type);
+		VariableExpression(Symbol name, unsigned int type, unsigned int length = 0);
+		// A reference to a known variable, which was checked when it was read
+		VariableExpression(const VariableInfo& var) : Expression(var.type), name(var.name) { listLength = var.length; }
 
 		virtual VariableExpression* clone() const override { return new VariableExpression(*this); }
 
 		std::string print(bool hex=false) const override;
-		bool hasSideEffect() override { return false; }
+		bool hasSideEffect() const override { return false; }
 		IntType getIntType() override { return (type == ValueType::INT) ? IntegerSimple : IntegerInvalid; }
+
+	protected:
+		size_t hashNode() const override;
+		bool equalNode(const Expression& other) const override;
 };
 
 class ListExpression: public Expression {
 	private:
-		std::vector<Value> elements;
+		ValueList elements;
 	public:
-		ListExpression(std::vector<Value> elements_);
+		ListExpression(ValueList elements_);
 		ListExpression(const ListExpression& copy);
 		virtual ListExpression* clone() const override { return new ListExpression(*this); }
 
 		std::string print(bool hex=false) const override;
 		// not really, have to check, but I don't want this to silently fail
-		bool hasSideEffect() override { return true; }
-
+		bool hasSideEffect() const override { return true; }
 
+	protected:
+		size_t hashNode() const override;
+		bool equalNode(const Expression& other) const override;
 };
 
 class ErrValueExpr: public Expression {
 	public:
-		ErrValueExpr(std::string err="", unsigned int address=0xFFFFFFFF);
+		// The parser records what went wrong as a diagnostic, so it makes these quietly
+		ErrValueExpr() {}
+		ErrValueExpr(std::string err, unsigned int address=0xFFFFFFFF);
 		std::string print(bool hex=false) const override;
 		IntType getIntType() override { return IntegerInvalid; }
 
 		virtual ErrValueExpr* clone() const override { return new ErrValueExpr(); }
 
+	protected:
+		// Nothing is known about what went wrong, so an error is only ever equal to itself
+		size_t hashNode() const override { return 0; }
+		bool equalNode(const Expression&) const override { return false; }
 };
 
 // This might only come up with weird debugging conditions
@@ -239,14 +302,18 @@ class NotExpr: public Expression {
 		IntType getIntType() override { return IntegerBool; }
 
 		virtual int getPrecedence() const override;
+
+	protected:
+		size_t hashNode() const override;
+		bool equalNode(const Expression& other) const override;
 };
 
 // Represents the target of the call (loosely)
 class FunctionExpr: public Expression {
-	std::string name;
+	Symbol name;
 	Value callValue;
 	public:
-		FunctionExpr(std::string name_) : name(name_) {}
+		FunctionExpr(Symbol name_) : name(name_) {}
 		FunctionExpr(Value val_) : callValue(std::move(val_)) {}
 		FunctionExpr(const FunctionExpr& copy);
 		virtual FunctionExpr* clone() const override { return new FunctionExpr(*this); }
@@ -259,6 +326,10 @@ class FunctionExpr: public Expression {
 		// if it is special
 		bool hasExtra = false;
 		unsigned int extraCall = 0;
+
+	protected:
+		size_t hashNode() const override;
+		bool equalNode(const Expression& other) const override;
 };
 
 
@@ -266,29 +337,37 @@ class FunctionExpr: public Expression {
 class CallExpr: public Expression {
 	FunctionExpr* callFunc = nullptr;
 	unsigned int fnOption = 0;
-	std::vector<unsigned int> fnExtra;
+	TypeList fnExtra;
 	protected:
-		std::vector<Value> fnArgs;
+		ValueList fnArgs;
 		CallExpr() : callFunc(new FunctionExpr("undefined")) {}
 	public:
-		CallExpr(FunctionExpr* callFunc, unsigned int option, std::vector<Value> args, std::vector<unsigned int> extraList, unsigned int returnType);
+		CallExpr(FunctionExpr* callFunc, unsigned int option, ValueList args, TypeList extraList, unsigned int returnType);
 		CallExpr(const CallExpr& copy);
 		~CallExpr();
 		virtual CallExpr* clone() const override { return new CallExpr(*this); }
 
 		std::string print(bool hex=false) const override;
-		bool hasSideEffect() override { return true; }
+		bool hasSideEffect() const override { return true; }
 		IntType getIntType() override;
+
+	protected:
+		size_t hashNode() const override;
+		bool equalNode(const Expression& other) const override;
 };
 
 // Near absolute call
 class ShortCallExpr: public CallExpr {
 	unsigned int blockIndex = 0;
 	public:
-		ShortCallExpr(unsigned int blockIndex, std::vector<Value> args);
+		ShortCallExpr(unsigned int blockIndex, ValueList args);
 		virtual ShortCallExpr* clone() const override { return new ShortCallExpr(*this); }
 
 		std::string print(bool hex=false) const override;
+
+	protected:
+		size_t hashNode() const override;
+		bool equalNode(const Expression& other) const override;
 };
 
 
@@ -308,6 +387,9 @@ class Statement {
 	public:
 		virtual ~Statement() {};
 
+		static void* operator new(size_t size) { return Arena::allocateNode(size); }
+		static void operator delete(void* p) { Arena::freeNode(p); }
+
 		virtual void print(std::ostream &out, int indentation = 0) const = 0;
 
 		virtual IfStatement* makeIf(Value cond, StatementBlock block);
@@ -438,9 +520,9 @@ class ContinueStatement: public Statement {
 };
 
 class ReturnStatement: public Statement {
-	std::vector<Value> values;
+	ValueList values;
 	public:
-		ReturnStatement(std::vector<Value> ret) : values(std::move(ret)) { type = RETURN; }
+		ReturnStatement(ValueList ret) : values(std::move(ret)) { type = RETURN; }
 
 		virtual void print(std::ostream &out, int indentation = 0) const override;
 };
@@ -0,0 +1,66 @@
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <stdexcept>
+
+#include "Symbol.h"
+
+// Names sit in fixed pages that never move, so a page pointer is all a reader needs
+// Pages are only ever added, under the lock, and published with release so readers can go without it
+static const unsigned int PAGE_BITS = 10;
+static const unsigned int PAGE_SIZE = 1 << PAGE_BITS;
+static const unsigned int MAX_PAGES = 1 << 12;
+// Per thread, so a long-lived worker doesn't end up with a copy of every name
+static const unsigned int MAX_SEEN = 1 << 12;
+
+static std::atomic<std::string*> pages[MAX_PAGES];
+
+static std::mutex internLock;
+static std::unordered_map<std::string, unsigned int>& internedIds() {
+	static std::unordered_map<std::string, unsigned int> ids;
+	return ids;
+}
+static unsigned int numSymbols = 1;
+
+static std::string* getPage(unsigned int page) {
+	return pages[page].load(std::memory_order_acquire);
+}
+
+static unsigned int intern(const std::string& name) {
+	// Most names are seen over and over by the same thread
+	static thread_local std::unordered_map<std::string, unsigned int> seen;
+	auto it = seen.find(name);
+	if (it != seen.end())
+		return it->second;
+
+	std::lock_guard<std::mutex> lock(internLock);
+	auto inserted = internedIds().insert(std::make_pair(name, numSymbols));
+	unsigned int id = inserted.first->second;
+	if (inserted.second) {
+		unsigned int page = id >> PAGE_BITS;
+		if (page >= MAX_PAGES)
+			throw std::runtime_error("Too many distinct names (limit " + std::to_string(MAX_PAGES * PAGE_SIZE) + ")");
+		std::string* pPage = getPage(page);
+		if (pPage == nullptr) {
+			pPage = new std::string[PAGE_SIZE];
+			pages[page].store(pPage, std::memory_order_release);
+		}
+		pPage[id & (PAGE_SIZE - 1)] = name;
+		numSymbols++;
+	}
+
+	// Starting over is cheap, the names that matter come straight back
+	if (seen.size() >= MAX_SEEN)
+		seen.clear();
+	seen.insert(std::make_pair(name, id));
+	return id;
+}
+
+Symbol::Symbol(const std::string& name) : id(name.empty() ? 0 : intern(name)) {}
+
+const std::string& Symbol::str() const {
+	static const std::string emptyName;
+	if (id == 0)
+		return emptyName;
+	return getPage(id >> PAGE_BITS)[id & (PAGE_SIZE - 1)];
+}
@@ -0,0 +1,37 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <string>
+#include <ostream>
+#include <functional>
+
+// A name (of a variable, command or function) kept once for the whole process
+// Copying or comparing one is copying or comparing an int, however many nodes and scenes use it
+// Making one takes a lock when the thread hasn't seen the name lately, reading it back never does
+class Symbol {
+	unsigned int id = 0;	// 0 is the empty name
+	public:
+		Symbol() {}
+		Symbol(const std::string& name);
+		Symbol(const char* name) : Symbol(std::string(name)) {}
+
+		// Good for as long as the process
+		const std::string& str() const;
+		unsigned int getId() const { return id; }
+		bool empty() const { return id == 0; }
+
+		bool operator ==(const Symbol& other) const { return id == other.id; }
+		bool operator !=(const Symbol& other) const { return id != other.id; }
+};
+
+inline std::ostream& operator <<(std::ostream& stream, const Symbol& symbol) {
+	return stream << symbol.str();
+}
+
+namespace std {
+	template <> struct hash<Symbol> {
+		size_t operator()(const Symbol& symbol) const { return std::hash<unsigned int>()(symbol.getId()); }
+	};
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+// State of one parallelFor, shared with the helper tasks that may only start after it returns
+struct ParallelLoop {
+	std::function<void(unsigned int)> fn;
+	unsigned int count;
+	std::atomic<unsigned int> next, finished;
+	std::mutex mutex;
+	std::condition_variable done;
+
+	ParallelLoop(std::function<void(unsigned int)> fn_, unsigned int count_) : fn(std::move(fn_)), count(count_), next(0), finished(0) {}
+
+	void run() {
+		unsigned int i;
+		while ((i = next++) < count) {
+			fn(i);
+			if (++finished == count) {
+				std::lock_guard<std::mutex> lock(mutex);
+				done.notify_all();
+			}
+		}
+	}
+};
+
+ThreadPool::ThreadPool(unsigned int numThreads) {
+	if (numThreads == 0)
+		numThreads = std::thread::hardware_concurrency();
+	if (numThreads == 0)
+		numThreads = 1;
+
+	workers.reserve(numThreads);
+	for (unsigned int i = 0; i < numThreads; i++)
+		workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	available.notify_all();
+	for (auto& worker:workers)
+		worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	available.notify_one();
+}
+
+void ThreadPool::work() {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if (tasks.empty())
+				return;
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		// Tasks deal with their own errors
+		task();
+	}
+}
+
+void ThreadPool::parallelFor(unsigned int count, std::function<void(unsigned int)> fn) {
+	if (count == 0)
+		return;
+
+	auto pLoop = std::make_shared<ParallelLoop>(std::move(fn), count);
+	unsigned int numHelpers = std::min(count - 1, size());
+	for (unsigned int i = 0; i < numHelpers; i++)
+		submit([pLoop]() { pLoop->run(); });
+
+	pLoop->run();
+
+	std::unique_lock<std::mutex> lock(pLoop->mutex);
+	pLoop->done.wait(lock, [&pLoop]() { return pLoop->finished == pLoop->count; });
+}
@@ -0,0 +1,38 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Fixed set of worker threads running tasks in submission order
+class ThreadPool {
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable available;
+	bool stopping = false;
+
+	void work();
+	public:
+		// 0 threads uses one per core
+		ThreadPool(unsigned int numThreads = 0);
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		// Finishes every queued task
+		~ThreadPool();
+
+		unsigned int size() const { return workers.size(); }
+
+		void submit(std::function<void()> task);
+
+		// Runs fn(0) ... fn(count - 1) on the pool and the calling thread, returning once all are done
+		// The caller keeps working instead of blocking, so this can be called from inside a task
+		// fn must not throw
+		void parallelFor(unsigned int count, std::function<void(unsigned int)> fn);
+};
+
+#endif